@@ -22,6 +22,9 @@ include device/phytec/pcm049/Config.mk
 BOARD_USES_GENERIC_AUDIO := false
 USE_CAMERA_STUB := true
 
+# no mixer_ctl_set_array() in this libtinyalsa, see audio/Android.mk
+TINYALSA_CTL_ARRAY := false
+
 OMAP_ENHANCEMENT := true
 OMAP_ENHANCEMENT_MULTIGPU := true
 
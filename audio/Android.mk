@@ -14,6 +14,15 @@
 
 LOCAL_PATH := $(call my-dir)
 
+# set TINYALSA_CTL_ARRAY := true when libtinyalsa has mixer_ctl_get_array()
+# and mixer_ctl_set_array(), to read and write int and bool ctls in one ioctl.
+# The JB libtinyalsa this board builds against has neither, so BoardConfig.mk
+# leaves it unset and multi-value ctls still take one ioctl per value here.
+audio_route_cflags :=
+ifeq ($(TINYALSA_CTL_ARRAY),true)
+audio_route_cflags += -DMIXER_CTL_ARRAY
+endif
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE := audio.primary.pcm049
@@ -21,6 +30,8 @@ LOCAL_MODULE := audio.primary.pcm049
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)/hw
 LOCAL_SRC_FILES := \
 	audio_hw.c \
+	audio_convert.c \
+	audio_ring.c \
 	audio_route.c
 LOCAL_C_INCLUDES += \
 	external/tinyalsa/include \
@@ -28,6 +39,61 @@ LOCAL_C_INCLUDES += \
 	$(call include-path-for, audio-utils)
 LOCAL_SHARED_LIBRARIES := liblog libcutils libtinyalsa libaudioutils libexpat
 LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += $(audio_route_cflags)
+
+# set AUDIO_HW_TRACE := true to record the event trace printed by adev_dump()
+ifeq ($(AUDIO_HW_TRACE),true)
+LOCAL_CFLAGS += -DAUDIO_HW_TRACE
+LOCAL_SRC_FILES += audio_trace.c
+endif
+
+# set AUDIO_HW_CAPTURE_POSITION := true when audio_stream_in has
+# get_capture_position(), which the input capture thread can answer
+ifeq ($(AUDIO_HW_CAPTURE_POSITION),true)
+LOCAL_CFLAGS += -DAUDIO_HW_CAPTURE_POSITION
+endif
 
 include $(BUILD_SHARED_LIBRARY)
 
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_route_compile
+
+LOCAL_SRC_FILES := \
+	audio_route_compile.c \
+	audio_route.c
+LOCAL_C_INCLUDES += \
+	external/tinyalsa/include \
+	external/expat/lib
+LOCAL_SHARED_LIBRARIES := liblog libcutils libtinyalsa libexpat
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += $(audio_route_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_route_bench
+
+LOCAL_SRC_FILES := \
+	audio_route_bench.c \
+	audio_route.c
+LOCAL_C_INCLUDES += \
+	external/tinyalsa/include \
+	external/expat/lib
+LOCAL_SHARED_LIBRARIES := liblog libcutils libtinyalsa libexpat
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += $(audio_route_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_trace_decode
+
+LOCAL_SRC_FILES := audio_trace_decode.c
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(call all-makefiles-under,$(LOCAL_PATH))
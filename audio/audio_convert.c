@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+
+#include "audio_convert.h"
+
+/*
+ * Each function runs its NEON loop on blocks of 8 frames or samples, then
+ * finishes the tail with the portable loop, which must give the same result.
+ * The NEON loops of the in place capable functions load a whole block
+ * before storing a smaller one, so dst == src is safe.
+ */
+
+#define FLOAT_SCALE 32768.0f
+
+static inline int16_t float_to_s16(float f)
+{
+    float x = f * FLOAT_SCALE;
+
+    /* same results as vcvtq_s32_f32() followed by vqmovn_s32() */
+    if (x != x)
+        return 0;
+    if (x >= 32767.0f)
+        return 32767;
+    if (x <= -32768.0f)
+        return -32768;
+    return (int16_t)(int32_t)x;
+}
+
+void audio_extract_channel_s16(int16_t *dst, const int16_t *src,
+                               size_t frames, unsigned int channel)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(src + i * 2);
+        vst1q_s16(dst + i, channel ? v.val[1] : v.val[0]);
+    }
+#endif
+    for (; i < frames; i++)
+        dst[i] = src[i * 2 + channel];
+}
+
+void audio_deinterleave_s16(int16_t *left, int16_t *right,
+                            const int16_t *src, size_t frames)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(src + i * 2);
+        vst1q_s16(left + i, v.val[0]);
+        vst1q_s16(right + i, v.val[1]);
+    }
+#endif
+    for (; i < frames; i++) {
+        left[i] = src[i * 2];
+        right[i] = src[i * 2 + 1];
+    }
+}
+
+void audio_downmix_s16(int16_t *dst, const int16_t *src, size_t frames)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(src + i * 2);
+        vst1q_s16(dst + i, vhaddq_s16(v.val[0], v.val[1]));
+    }
+#endif
+    for (; i < frames; i++)
+        dst[i] = (int16_t)(((int32_t)src[i * 2] + src[i * 2 + 1]) >> 1);
+}
+
+void audio_downmix_weighted_s16(int16_t *dst, const int16_t *src,
+                                size_t frames, int16_t left_weight,
+                                int16_t right_weight)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(src + i * 2);
+        int32x4_t lo = vmull_n_s16(vget_low_s16(v.val[0]), left_weight);
+        int32x4_t hi = vmull_n_s16(vget_high_s16(v.val[0]), left_weight);
+        lo = vmlal_n_s16(lo, vget_low_s16(v.val[1]), right_weight);
+        hi = vmlal_n_s16(hi, vget_high_s16(v.val[1]), right_weight);
+        vst1q_s16(dst + i, vcombine_s16(vqshrn_n_s32(lo, 15),
+                                        vqshrn_n_s32(hi, 15)));
+    }
+#endif
+    for (; i < frames; i++) {
+        int32_t sum = ((int32_t)src[i * 2] * left_weight +
+                       (int32_t)src[i * 2 + 1] * right_weight) >> 15;
+        if (sum > 32767)
+            sum = 32767;
+        else if (sum < -32768)
+            sum = -32768;
+        dst[i] = (int16_t)sum;
+    }
+}
+
+void audio_mono_to_stereo_s16(int16_t *dst, const int16_t *src,
+                              size_t frames)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = vld1q_s16(src + i);
+        v.val[1] = v.val[0];
+        vst2q_s16(dst + i * 2, v);
+    }
+#endif
+    for (; i < frames; i++) {
+        dst[i * 2] = src[i];
+        dst[i * 2 + 1] = src[i];
+    }
+}
+
+void audio_s16_to_s32(int32_t *dst, const int16_t *src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_s32(dst + i, vshll_n_s16(vget_low_s16(v), 16));
+        vst1q_s32(dst + i + 4, vshll_n_s16(vget_high_s16(v), 16));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = (int32_t)src[i] * 65536;
+}
+
+void audio_s32_to_s16(int16_t *dst, const int32_t *src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= count; i += 8) {
+        int32x4_t lo = vld1q_s32(src + i);
+        int32x4_t hi = vld1q_s32(src + i + 4);
+        vst1q_s16(dst + i, vcombine_s16(vshrn_n_s32(lo, 16),
+                                        vshrn_n_s32(hi, 16)));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = (int16_t)(src[i] >> 16);
+}
+
+void audio_s16_to_float(float *dst, const int16_t *src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, 1.0f / FLOAT_SCALE));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, 1.0f / FLOAT_SCALE));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = src[i] * (1.0f / FLOAT_SCALE);
+}
+
+void audio_float_to_s16(int16_t *dst, const float *src, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __ARM_NEON__
+    for (; i + 8 <= count; i += 8) {
+        float32x4_t lo = vmulq_n_f32(vld1q_f32(src + i), FLOAT_SCALE);
+        float32x4_t hi = vmulq_n_f32(vld1q_f32(src + i + 4), FLOAT_SCALE);
+        vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)),
+                                        vqmovn_s32(vcvtq_s32_f32(hi))));
+    }
+#endif
+    for (; i < count; i++)
+        dst[i] = float_to_s16(src[i]);
+}
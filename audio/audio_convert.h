@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_CONVERT_H
+#define AUDIO_CONVERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Channel and sample format conversion of 16 bit PCM buffers. NEON is used
+   when available, and the portable versions give bit-exact results. Unless
+   noted otherwise dst may be equal to src, but must not otherwise overlap. */
+
+/* Copies one channel (0 or 1) of a stereo buffer into a mono buffer */
+void audio_extract_channel_s16(int16_t *dst, const int16_t *src,
+                               size_t frames, unsigned int channel);
+
+/* Splits a stereo buffer into two mono buffers, which must not overlap src */
+void audio_deinterleave_s16(int16_t *left, int16_t *right,
+                            const int16_t *src, size_t frames);
+
+/* Mixes a stereo buffer down to mono, each sample being (left + right) >> 1 */
+void audio_downmix_s16(int16_t *dst, const int16_t *src, size_t frames);
+
+/* Mixes a stereo buffer down to mono with Q15 weights in [0, 32767]. Each
+   sample is (left * left_weight + right * right_weight) >> 15, saturated */
+void audio_downmix_weighted_s16(int16_t *dst, const int16_t *src,
+                                size_t frames, int16_t left_weight,
+                                int16_t right_weight);
+
+/* Duplicates a mono buffer into both channels of a stereo buffer. src may be
+   the second half of dst, to upmix in place, but must not otherwise overlap */
+void audio_mono_to_stereo_s16(int16_t *dst, const int16_t *src,
+                              size_t frames);
+
+/* Sample format conversions of count samples. s16 to s32 fills the low 16
+   bits with zeros, s32 to s16 drops them. Floats are in [-1.0, 1.0) and are
+   clamped and truncated towards zero when going back to s16. Conversions to
+   a larger sample must not be done in place. */
+void audio_s16_to_s32(int32_t *dst, const int16_t *src, size_t count);
+void audio_s32_to_s16(int16_t *dst, const int32_t *src, size_t count);
+void audio_s16_to_float(float *dst, const int16_t *src, size_t count);
+void audio_float_to_s16(int16_t *dst, const float *src, size_t count);
+
+#endif
@@ -19,10 +19,17 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
 #include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
 
+#include <cutils/atomic.h>
 #include <cutils/log.h>
 #include <cutils/properties.h>
 #include <cutils/str_parms.h>
@@ -36,29 +43,128 @@
 
 #include <audio_utils/resampler.h>
 
+#include "audio_convert.h"
+#include "audio_ring.h"
 #include "audio_route.h"
+#include "audio_trace.h"
 
 #define PCM_CARD 0
 #define PCM_DEVICE 0
 #define PCM_DEVICE_SCO 2
 
+/*
+ * All open PCMs can only use a single group of rates at once:
+ * Group 1: 11.025, 22.05, 44.1
+ * Group 2: 8, 16, 32, 48
+ * A main PCM opens at the rate of the group of its stream, or joins the
+ * group of the PCM already open in the other direction, the stream then
+ * going through a resampler. Playback and capture thus never close each
+ * other, except for SCO which requires group 2 (see pcm_get_rate()).
+ */
+#define PCM_SAMPLING_RATE_11025 44100
+#define PCM_SAMPLING_RATE_8000 48000
+/* rate of the PCM configs below, the stream buffer sizes being derived
+ * from the highest rate so that a buffer fits a period in either group */
+#define PCM_SAMPLING_RATE PCM_SAMPLING_RATE_8000
+
 #define OUT_PERIOD_SIZE 800
 #define OUT_SHORT_PERIOD_COUNT 2
 #define OUT_LONG_PERIOD_COUNT 8
 #define OUT_SAMPLING_RATE 44100
 
+/* low latency output, used for AUDIO_OUTPUT_FLAG_FAST */
+#define OUT_FAST_PERIOD_SIZE 256
+#define OUT_FAST_PERIOD_COUNT 4
+
 #define IN_PERIOD_SIZE 1024
 #define IN_PERIOD_COUNT 4
-#define IN_SAMPLING_RATE 44100
 
 #define SCO_PERIOD_SIZE 256
 #define SCO_PERIOD_COUNT 4
 #define SCO_SAMPLING_RATE 8000
 
+/* resampler quality of new streams, one of the names in resampler_qualities */
+#define RESAMPLER_QUALITY_PROPERTY "audio.resampler.quality"
+/* per-stream override, applied when the stream next leaves standby */
+#define AUDIO_PARAMETER_RESAMPLER_QUALITY "resampler_quality"
+
+/* PCM transport of new streams: "1" or "true" maps the DMA ring and fills
+ * or drains it in place, otherwise pcm_write()/pcm_read() are used. Streams
+ * fall back to pcm_write()/pcm_read() if the driver cannot mmap the PCM */
+#define OUT_MMAP_PROPERTY "audio.mmap.output"
+#define IN_MMAP_PROPERTY "audio.mmap.input"
+
+/* decoupled output: "1" or "true" makes out_write() of new output streams
+ * queue into a ring, drained to the PCM by a writer thread of the stream */
+#define OUT_WRITER_THREAD_PROPERTY "audio.output.writer_thread"
+/* minimum ring size, in stream buffers (see out_get_buffer_size()) */
+#define OUT_RING_BUFFER_COUNT 2
+/* decoupled input: "1" or "true" makes a capture thread of new input
+ * streams read periods into a ring, which in_read() is served from */
+#define IN_CAPTURE_THREAD_PROPERTY "audio.input.capture_thread"
+/* minimum ring size, in stream buffers (see in_get_buffer_size()) */
+#define IN_RING_BUFFER_COUNT 4
+/* SCHED_FIFO priority of the writer and capture threads, and their nice
+ * value when the process may not use SCHED_FIFO
+ * (ANDROID_PRIORITY_URGENT_AUDIO) */
+#define STREAM_THREAD_FIFO_PRIORITY 2
+#define STREAM_THREAD_NICE (-19)
+
+/* Q15 weight of 1.0 for the weighted capture downmix */
+#define DOWNMIX_WEIGHT_ONE 32767
+
 /* minimum sleep time in out_write() when write threshold is not reached */
 #define MIN_WRITE_SLEEP_US 2000
 #define MAX_WRITE_SLEEP_US ((OUT_PERIOD_SIZE * OUT_SHORT_PERIOD_COUNT * 1000000) \
-                                / OUT_SAMPLING_RATE)
+                                / PCM_SAMPLING_RATE)
+
+/* out_write() sleeps on the clock the driver stamps the hw pointer with */
+#ifdef PCM_MONOTONIC
+#define OUT_PCM_FLAGS (PCM_OUT | PCM_NORESTART | PCM_MONOTONIC)
+#define OUT_PACING_CLOCK CLOCK_MONOTONIC
+#else
+#define OUT_PCM_FLAGS (PCM_OUT | PCM_NORESTART)
+#define OUT_PACING_CLOCK CLOCK_REALTIME
+#endif
+
+#define NSEC_PER_SEC 1000000000LL
+
+/* get_parameters() key of the stream statistics, see get_stream_parameters() */
+#define AUDIO_PARAMETER_STREAM_STATS "stats"
+
+/* upper bounds in ms of the call and sleep time histogram buckets, the last
+ * bucket counting everything longer */
+#define STATS_HISTOGRAM_SIZE 8
+static const unsigned int stats_histogram_limits_ms[STATS_HISTOGRAM_SIZE - 1] = {
+    1, 2, 5, 10, 20, 50, 100,
+};
+/* ring fill level histogram buckets: below 1/4, 1/2, 3/4, and above */
+#define STATS_RING_FILL_SIZE 4
+/* open streams adev_dump() reports on */
+#define MAX_DUMPED_STREAMS 8
+
+/* mixer paths used by select_devices(), resolved once in adev_open() */
+enum {
+    ROUTE_SPEAKER,
+    ROUTE_HEADPHONE,
+    ROUTE_DOCK,
+    ROUTE_MIC,
+    ROUTE_COUNT,
+};
+
+static const char * const route_path_names[ROUTE_COUNT] = {
+    [ROUTE_SPEAKER] = "speaker",
+    [ROUTE_HEADPHONE] = "headphone",
+    [ROUTE_DOCK] = "dock",
+    [ROUTE_MIC] = "mic",
+};
+
+/* bits of audio_device.stream_state */
+enum {
+    STREAM_STATE_SCREEN_OFF = 0x1,
+    STREAM_STATE_INPUT_ACTIVE = 0x2,
+    STREAM_STATE_OUT_SCO = 0x4,
+};
 
 enum {
     OUT_BUFFER_TYPE_UNKNOWN,
@@ -68,16 +174,25 @@ enum {
 
 struct pcm_config pcm_config_out = {
     .channels = 2,
-    .rate = OUT_SAMPLING_RATE,
+    .rate = PCM_SAMPLING_RATE,
     .period_size = OUT_PERIOD_SIZE,
     .period_count = OUT_LONG_PERIOD_COUNT,
     .format = PCM_FORMAT_S16_LE,
     .start_threshold = OUT_PERIOD_SIZE * OUT_SHORT_PERIOD_COUNT,
 };
 
+struct pcm_config pcm_config_out_fast = {
+    .channels = 2,
+    .rate = PCM_SAMPLING_RATE,
+    .period_size = OUT_FAST_PERIOD_SIZE,
+    .period_count = OUT_FAST_PERIOD_COUNT,
+    .format = PCM_FORMAT_S16_LE,
+    .start_threshold = OUT_FAST_PERIOD_SIZE * OUT_SHORT_PERIOD_COUNT,
+};
+
 struct pcm_config pcm_config_in = {
     .channels = 2,
-    .rate = IN_SAMPLING_RATE,
+    .rate = PCM_SAMPLING_RATE,
     .period_size = IN_PERIOD_SIZE,
     .period_count = IN_PERIOD_COUNT,
     .format = PCM_FORMAT_S16_LE,
@@ -85,6 +200,44 @@ struct pcm_config pcm_config_in = {
     .stop_threshold = (IN_PERIOD_SIZE * IN_PERIOD_COUNT),
 };
 
+/* stereo to mono downmix of the capture PCM */
+enum {
+    DOWNMIX_LEFT,
+    DOWNMIX_RIGHT,
+    DOWNMIX_AVERAGE,
+    DOWNMIX_WEIGHTED,
+};
+
+struct downmix {
+    int mode;
+    int16_t left_weight; /* Q15, for DOWNMIX_WEIGHTED */
+    int16_t right_weight;
+};
+
+/*
+ * Downmix used for each input device, read when the input stream starts:
+ * "left", "right", "average" (the default) or "<left>,<right>" with both
+ * weights in [0, 1], e.g. "0.7,0.3"
+ */
+static const struct {
+    audio_devices_t device;
+    const char *property;
+} input_downmix_properties[] = {
+    { AUDIO_DEVICE_IN_BUILTIN_MIC, "audio.downmix.builtin_mic" },
+    { AUDIO_DEVICE_IN_BACK_MIC, "audio.downmix.back_mic" },
+    { AUDIO_DEVICE_IN_WIRED_HEADSET, "audio.downmix.wired_headset" },
+};
+
+static const struct {
+    const char *name;
+    int quality;
+} resampler_qualities[] = {
+    { "low", RESAMPLER_QUALITY_MIN },
+    { "default", RESAMPLER_QUALITY_DEFAULT },
+    { "high", RESAMPLER_QUALITY_DESKTOP },
+    { "voip", RESAMPLER_QUALITY_VOIP },
+};
+
 struct pcm_config pcm_config_sco = {
     .channels = 1,
     .rate = SCO_SAMPLING_RATE,
@@ -102,11 +255,72 @@ struct audio_device {
     bool standby;
     bool mic_mute;
     struct audio_route *ar;
+    int route_path[ROUTE_COUNT];
     int orientation;
     bool screen_off;
 
     struct stream_out *active_out;
     struct stream_in *active_in;
+
+    /*
+     * Copy of screen_off, active_in and out_device as STREAM_STATE_* bits,
+     * updated with the hw device mutex held and read without it by
+     * out_write() and out_get_latency().
+     */
+    volatile int32_t stream_state;
+
+    /*
+     * Mixer changes are committed by route_thread, so that slow mixer
+     * ioctls are not made while holding the hw device mutex. Requests
+     * are coalesced: the thread only applies the most recent devices.
+     */
+    pthread_t route_thread;
+    pthread_mutex_t route_lock; /* protects the route request fields */
+    pthread_cond_t route_cond;
+    bool route_pending;
+    bool route_exit;
+    unsigned int route_out_device;
+    unsigned int route_in_device;
+
+    /* open streams, walked by adev_dump() without the hw device mutex */
+    pthread_mutex_t stream_list_lock; /* protects the lists only */
+    struct stream_out *out_list;
+    struct stream_in *in_list;
+};
+
+/*
+ * Statistics of a stream, updated with the stream mutex held and read
+ * without any lock by the dump and get_parameters() hooks, so that they
+ * never wait for a blocked write() or read(). seq is odd while an update
+ * is in progress, readers retry until they get a stable copy.
+ */
+struct stream_stats {
+    volatile int32_t seq;
+    uint64_t frames; /* written or read, at the stream sample rate */
+    uint64_t resampled_frames;
+    uint64_t copied_frames; /* staged in the stream buffer */
+    uint32_t xruns;
+    uint32_t standbys;
+    uint32_t call_ms[STATS_HISTOGRAM_SIZE]; /* write() or read() duration */
+    uint32_t sleep_ms[STATS_HISTOGRAM_SIZE]; /* pacing and error sleeps */
+    /* fill level of the stream ring, each time its consumer takes frames */
+    uint32_t ring_fill[STATS_RING_FILL_SIZE];
+};
+
+/* render position of an output, see out_get_position() */
+struct out_position {
+    uint64_t frames_since_standby; /* written, at the stream sample rate */
+    int64_t time_ns; /* when kernel_frames were queued, 0 without a PCM */
+    unsigned int kernel_frames;
+    unsigned int pcm_rate;
+};
+
+/* what adev_dump() copies of each open stream */
+struct stream_dump {
+    const void *stream;
+    bool input;
+    bool standby;
+    struct stream_stats stats;
 };
 
 struct stream_out {
@@ -114,36 +328,129 @@ struct stream_out {
 
     pthread_mutex_t lock; /* see note below on mutex acquisition order */
     struct pcm *pcm;
-    struct pcm_config *pcm_config;
+    struct pcm_config *pcm_config; /* &config, or &pcm_config_sco */
+    struct pcm_config config; /* default_config, at the rate of the PCM */
     bool standby;
+    struct stream_out *next; /* in adev->out_list */
+
+    /* pcm_config_out or pcm_config_out_fast, selected by the output flags */
+    struct pcm_config *default_config;
+    audio_output_flags_t flags;
 
     struct resampler_itfe *resampler;
+    int resampler_quality; /* protected by the hw device mutex */
     int16_t *buffer;
     size_t buffer_frames;
 
+    /* mmap transport requested at open, and used by the open PCM */
+    bool mmap_requested;
+    bool mmap;
+    /* an mmap PCM is started by out_write_mmap() */
+    bool pcm_started;
+
     int write_threshold;
     int cur_write_threshold;
     int buffer_type;
 
+    struct stream_stats stats;
+    /* updated along with stats, by out_write_pcm() and do_out_standby() */
+    struct out_position position;
+
+    /*
+     * Decoupled mode: out_write() only queues frames into ring, and
+     * writer_thread drains it to the PCM through out_write_pcm(). The
+     * writer_lock only serves the conditions, and the producer never
+     * takes the stream mutex.
+     */
+    bool decoupled;
+    struct audio_ring ring;
+    void *writer_buffer;
+    size_t writer_frames;
+    size_t writer_fill; /* ring fill sampled by the writer */
+    pthread_t writer_thread;
+    pthread_mutex_t writer_lock;
+    pthread_cond_t writer_cond; /* frames queued, or writer_exit set */
+    pthread_cond_t space_cond; /* the writer finished a buffer */
+    bool writer_busy;
+    bool writer_exit;
+
     struct audio_device *dev;
 };
 
+/* CLOCK_MONOTONIC capture time of the frame just before ring position */
+struct capture_anchor {
+    uint32_t position;
+    int64_t time_ns;
+};
+
 struct stream_in {
     struct audio_stream_in stream;
 
     pthread_mutex_t lock; /* see note below on mutex acquisition order */
     struct pcm *pcm;
-    struct pcm_config *pcm_config;
+    struct pcm_config *pcm_config; /* &config, or &pcm_config_sco */
+    struct pcm_config config; /* pcm_config_in, at the rate of the PCM */
     bool standby;
+    struct stream_in *next; /* in adev->in_list */
 
     unsigned int requested_rate;
+    audio_channel_mask_t channel_mask;
     struct resampler_itfe *resampler;
+    int resampler_quality; /* protected by the hw device mutex */
     struct resampler_buffer_provider buf_provider;
+    /* mmap transport requested at open, and used by the open PCM */
+    bool mmap_requested;
+    bool mmap;
+    /* the PCM was started, by a read or by start_input_stream() */
+    bool pcm_started;
+    struct downmix downmix;
     int16_t *buffer;
     size_t buffer_size;
     size_t frames_in;
     int read_status;
 
+    struct stream_stats stats;
+
+    /*
+     * Decoupled mode: capture_thread reads one stream buffer after the other
+     * through in_read_pcm() while capture_active is set, and queues them
+     * into ring, from which in_read() is served. capture_lock protects the
+     * capture_* fields and anchors, nothing else is taken while holding it.
+     */
+    bool decoupled;
+    struct audio_ring ring;
+    void *capture_buffer;
+    size_t capture_frames;
+    pthread_t capture_thread;
+    pthread_mutex_t capture_lock;
+    pthread_cond_t capture_cond; /* capture_active or capture_exit set */
+    pthread_cond_t data_cond; /* frames queued, or capture_busy cleared */
+    bool capture_active;
+    bool capture_busy;
+    bool capture_exit;
+    /* callers between in_pause_capture() and in_resume_capture(), in_read()
+     * may not restart capturing meanwhile */
+    int capture_pauses;
+    /* set by in_pause_capture(): the frames queued are stale, and the next
+     * in_read(), the only reader of the ring, drops them */
+    bool capture_flush;
+    /* set by in_read_pcm() when it leaves standby, and by in_pause_capture(),
+     * as the capture timeline then starts over */
+    bool capture_restarted;
+    /* capture time of the last frame read by in_read_pcm(), 0 if unknown */
+    int64_t capture_end_ns;
+    /* ring of the capture times of the queued buffers */
+    struct capture_anchor *anchors;
+    size_t anchor_count;
+    size_t anchor_next;
+    /* frames read by the client, and the position and capture time of the
+     * first frame of the last in_read(), see in_get_capture_position() */
+    uint64_t frames_read;
+    uint64_t capture_position;
+    int64_t capture_time_ns;
+    /* frames dropped since the last in_get_input_frames_lost() */
+    volatile int32_t frames_lost;
+
     struct audio_device *dev;
 };
 
@@ -164,45 +471,450 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
                                    struct resampler_buffer* buffer);
 static void release_buffer(struct resampler_buffer_provider *buffer_provider,
                                   struct resampler_buffer* buffer);
+static void in_pause_capture(struct stream_in *in);
+static void in_resume_capture(struct stream_in *in);
 
 /*
  * NOTE: when multiple mutexes have to be acquired, always take the
  * audio_device mutex first, followed by the stream_in and/or
- * stream_out mutexes.
+ * stream_out mutexes. The audio_device route_lock and stream_list_lock,
+ * the stream_out writer_lock and the stream_in capture_lock may be taken
+ * last, and nothing else may be acquired while holding them.
+ * out_write() and in_read() only take the audio_device mutex to leave
+ * standby, releasing their stream mutex first to respect this order.
+ * While an input capture thread is capturing, it is the only user of the
+ * stream_in mutex: in_standby() and in_set_parameters() stop it first.
  */
 
 /* Helper functions */
 
-static void select_devices(struct audio_device *adev)
+static int64_t stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/* the stream stats fields may only be changed between stats_begin() and
+ * stats_end(), with the stream mutex locked */
+static void stats_begin(struct stream_stats *stats)
+{
+    android_atomic_inc(&stats->seq);
+}
+
+static void stats_end(struct stream_stats *stats)
+{
+    android_atomic_inc(&stats->seq);
+}
+
+static void stats_add_time(uint32_t *histogram, int64_t ns)
+{
+    unsigned int i;
+
+    for (i = 0; i < STATS_HISTOGRAM_SIZE - 1; i++)
+        if (ns < stats_histogram_limits_ms[i] * 1000000LL)
+            break;
+    histogram[i]++;
+}
+
+static void stats_add_fill(uint32_t *histogram, size_t filled, size_t size)
+{
+    histogram[filled * STATS_RING_FILL_SIZE / (size + 1)]++;
+}
+
+/* copies stats without locking, retrying while they are being updated */
+static void stats_snapshot(const struct stream_stats *stats,
+                           struct stream_stats *copy)
+{
+    int32_t seq;
+
+    do {
+        seq = android_atomic_acquire_load(&stats->seq);
+        memcpy(copy, (const void *)stats, sizeof(*copy));
+    } while ((seq & 1) || seq != android_atomic_release_load(&stats->seq));
+}
+
+/* copies the render position of out without locking, retrying while it
+ * is being updated. The writer holds the stream mutex across pcm_write()
+ * and its pacing sleep, the position getters must not wait for it */
+static void out_get_position(const struct stream_out *out,
+                             struct out_position *position)
+{
+    int32_t seq;
+
+    do {
+        seq = android_atomic_acquire_load(&out->stats.seq);
+        memcpy(position, (const void *)&out->position, sizeof(*position));
+    } while ((seq & 1) ||
+             seq != android_atomic_release_load(&out->stats.seq));
+}
+
+/* prints histogram as comma separated counts */
+static int format_histogram(char *buffer, size_t size,
+                            const uint32_t *histogram, unsigned int buckets)
+{
+    unsigned int i;
+    int len = 0;
+
+    for (i = 0; i < buckets && len < (int)size; i++)
+        len += snprintf(buffer + len, size - len, "%s%u", i ? "," : "",
+                        histogram[i]);
+
+    return len;
+}
+
+/* writes a snapshot of stats to fd, for the dump hooks */
+static void dump_stream_stats(int fd, const struct stream_stats *stats)
+{
+    struct stream_stats s;
+    char call_ms[128];
+    char sleep_ms[128];
+    char ring_fill[64];
+    char buffer[640];
+    int len;
+
+    stats_snapshot(stats, &s);
+    format_histogram(call_ms, sizeof(call_ms), s.call_ms,
+                     STATS_HISTOGRAM_SIZE);
+    format_histogram(sleep_ms, sizeof(sleep_ms), s.sleep_ms,
+                     STATS_HISTOGRAM_SIZE);
+    format_histogram(ring_fill, sizeof(ring_fill), s.ring_fill,
+                     STATS_RING_FILL_SIZE);
+    len = snprintf(buffer, sizeof(buffer),
+                   "  frames %llu, resampled %llu, copied %llu\n"
+                   "  xruns %u, standbys %u\n"
+                   "  call time histogram (<1,<2,<5,<10,<20,<50,<100,>=100 ms): %s\n"
+                   "  sleep time histogram: %s\n"
+                   "  ring fill histogram (<1/4,<1/2,<3/4,>=3/4): %s\n",
+                   (unsigned long long)s.frames,
+                   (unsigned long long)s.resampled_frames,
+                   (unsigned long long)s.copied_frames,
+                   s.xruns, s.standbys, call_ms, sleep_ms, ring_fill);
+
+    if (len > (int)sizeof(buffer) - 1)
+        len = sizeof(buffer) - 1;
+    write(fd, buffer, len);
+}
+
+/* must be called with hw device mutex locked, whenever screen_off,
+ * active_in or out_device change */
+static void publish_stream_state(struct audio_device *adev)
+{
+    int32_t state = 0;
+
+    if (adev->screen_off)
+        state |= STREAM_STATE_SCREEN_OFF;
+    if (adev->active_in)
+        state |= STREAM_STATE_INPUT_ACTIVE;
+    if (adev->out_device & AUDIO_DEVICE_OUT_ALL_SCO)
+        state |= STREAM_STATE_OUT_SCO;
+
+    android_atomic_release_store(state, &adev->stream_state);
+}
+
+static void get_input_downmix(unsigned int in_device, struct downmix *downmix)
+{
+    char value[PROPERTY_VALUE_MAX];
+    unsigned int i;
+    float left;
+    float right;
+
+    downmix->mode = DOWNMIX_AVERAGE;
+
+    for (i = 0; i < sizeof(input_downmix_properties) /
+                        sizeof(input_downmix_properties[0]); i++)
+        if (in_device & input_downmix_properties[i].device &
+                ~AUDIO_DEVICE_BIT_IN)
+            break;
+    if (i == sizeof(input_downmix_properties) /
+                 sizeof(input_downmix_properties[0]) ||
+            property_get(input_downmix_properties[i].property, value, "") <= 0)
+        return;
+
+    if (strcmp(value, "left") == 0) {
+        downmix->mode = DOWNMIX_LEFT;
+    } else if (strcmp(value, "right") == 0) {
+        downmix->mode = DOWNMIX_RIGHT;
+    } else if (strcmp(value, "average") == 0) {
+        downmix->mode = DOWNMIX_AVERAGE;
+    } else if ((sscanf(value, "%f,%f", &left, &right) == 2) &&
+               (left >= 0.0f) && (left <= 1.0f) &&
+               (right >= 0.0f) && (right <= 1.0f)) {
+        downmix->mode = DOWNMIX_WEIGHTED;
+        downmix->left_weight = (int16_t)(left * DOWNMIX_WEIGHT_ONE + 0.5f);
+        downmix->right_weight = (int16_t)(right * DOWNMIX_WEIGHT_ONE + 0.5f);
+    } else {
+        ALOGW("Unknown %s=%s, averaging channels",
+              input_downmix_properties[i].property, value);
+    }
+}
+
+/* reduces stereo frames from the PCM to mono, dst may be equal to src */
+static void in_downmix(struct stream_in *in, int16_t *dst, const int16_t *src,
+                       size_t frames)
+{
+    switch (in->downmix.mode) {
+    case DOWNMIX_LEFT:
+        audio_extract_channel_s16(dst, src, frames, 0);
+        break;
+    case DOWNMIX_RIGHT:
+        audio_extract_channel_s16(dst, src, frames, 1);
+        break;
+    case DOWNMIX_WEIGHTED:
+        audio_downmix_weighted_s16(dst, src, frames, in->downmix.left_weight,
+                                   in->downmix.right_weight);
+        break;
+    default:
+        audio_downmix_s16(dst, src, frames);
+        break;
+    }
+}
+
+/* converts frames read from the PCM to the stream channel count. When
+ * downmixing dst may be equal to src, when upmixing the mono SCO PCM src
+ * may be the second half of dst */
+static void in_adapt_channels(struct stream_in *in, int16_t *dst,
+                              const int16_t *src, size_t frames)
+{
+    if (in->pcm_config->channels == 2)
+        in_downmix(in, dst, src, frames);
+    else
+        audio_mono_to_stereo_s16(dst, src, frames);
+}
+
+static int resampler_quality_from_name(const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(resampler_qualities) / sizeof(resampler_qualities[0]); i++)
+        if (strcmp(name, resampler_qualities[i].name) == 0)
+            return resampler_qualities[i].quality;
+
+    return -1;
+}
+
+static const char *resampler_quality_name(int quality)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(resampler_qualities) / sizeof(resampler_qualities[0]); i++)
+        if (resampler_qualities[i].quality == quality)
+            return resampler_qualities[i].name;
+
+    return "default";
+}
+
+static int get_default_resampler_quality(void)
+{
+    char value[PROPERTY_VALUE_MAX];
+    int quality;
+
+    property_get(RESAMPLER_QUALITY_PROPERTY, value, "default");
+    quality = resampler_quality_from_name(value);
+    if (quality < 0) {
+        ALOGW("Unknown %s=%s", RESAMPLER_QUALITY_PROPERTY, value);
+        quality = RESAMPLER_QUALITY_DEFAULT;
+    }
+
+    return quality;
+}
+
+static bool get_bool_property(const char *key)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    property_get(key, value, "0");
+
+    return strcmp(value, "1") == 0 || strcmp(value, "true") == 0;
+}
+
+/* parses AUDIO_PARAMETER_RESAMPLER_QUALITY, must be called with the hw
+ * device mutex locked. Returns -ENOENT if the key is absent */
+static int set_resampler_quality_parameter(struct str_parms *parms,
+                                           int *resampler_quality)
+{
+    char value[32];
+    int quality;
+
+    if (str_parms_get_str(parms, AUDIO_PARAMETER_RESAMPLER_QUALITY,
+                          value, sizeof(value)) < 0)
+        return -ENOENT;
+
+    quality = resampler_quality_from_name(value);
+    if (quality < 0)
+        return -EINVAL;
+
+    *resampler_quality = quality;
+    return 0;
+}
+
+/* answers AUDIO_PARAMETER_RESAMPLER_QUALITY and AUDIO_PARAMETER_STREAM_STATS
+ * queries, the stats being read without locking */
+static char *get_stream_parameters(const char *keys, int resampler_quality,
+                                   const struct stream_stats *stats)
+{
+    struct str_parms *query = str_parms_create_str(keys);
+    struct str_parms *reply = str_parms_create();
+    char *str;
+
+    if (str_parms_has_key(query, AUDIO_PARAMETER_RESAMPLER_QUALITY))
+        str_parms_add_str(reply, AUDIO_PARAMETER_RESAMPLER_QUALITY,
+                          resampler_quality_name(resampler_quality));
+    /* "stats" expands to the stats_* keys, histograms being comma lists */
+    if (str_parms_has_key(query, AUDIO_PARAMETER_STREAM_STATS)) {
+        struct stream_stats s;
+        char value[128];
+
+        stats_snapshot(stats, &s);
+        snprintf(value, sizeof(value), "%llu", (unsigned long long)s.frames);
+        str_parms_add_str(reply, "stats_frames", value);
+        snprintf(value, sizeof(value), "%llu",
+                 (unsigned long long)s.resampled_frames);
+        str_parms_add_str(reply, "stats_resampled_frames", value);
+        snprintf(value, sizeof(value), "%llu",
+                 (unsigned long long)s.copied_frames);
+        str_parms_add_str(reply, "stats_copied_frames", value);
+        str_parms_add_int(reply, "stats_xruns", s.xruns);
+        str_parms_add_int(reply, "stats_standbys", s.standbys);
+        format_histogram(value, sizeof(value), s.call_ms,
+                         STATS_HISTOGRAM_SIZE);
+        str_parms_add_str(reply, "stats_call_ms", value);
+        format_histogram(value, sizeof(value), s.sleep_ms,
+                         STATS_HISTOGRAM_SIZE);
+        str_parms_add_str(reply, "stats_sleep_ms", value);
+        format_histogram(value, sizeof(value), s.ring_fill,
+                         STATS_RING_FILL_SIZE);
+        str_parms_add_str(reply, "stats_ring_fill", value);
+    }
+    str = str_parms_to_str(reply);
+
+    str_parms_destroy(query);
+    str_parms_destroy(reply);
+    return str;
+}
+
+/* called from the routing thread only, it is the sole user of adev->ar */
+static void apply_route(struct audio_device *adev, unsigned int out_device,
+                        unsigned int in_device)
 {
     int headphone_on;
     int speaker_on;
     int docked;
     int main_mic_on;
+    int path[ROUTE_COUNT];
+    unsigned int num_paths = 0;
 
-    headphone_on = adev->out_device & (AUDIO_DEVICE_OUT_WIRED_HEADSET |
+    headphone_on = out_device & (AUDIO_DEVICE_OUT_WIRED_HEADSET |
                                     AUDIO_DEVICE_OUT_WIRED_HEADPHONE);
-    speaker_on = adev->out_device & AUDIO_DEVICE_OUT_SPEAKER;
-    docked = adev->out_device & AUDIO_DEVICE_OUT_ANLG_DOCK_HEADSET;
-    main_mic_on = adev->in_device & AUDIO_DEVICE_IN_BUILTIN_MIC;
+    speaker_on = out_device & AUDIO_DEVICE_OUT_SPEAKER;
+    docked = out_device & AUDIO_DEVICE_OUT_ANLG_DOCK_HEADSET;
+    main_mic_on = in_device & AUDIO_DEVICE_IN_BUILTIN_MIC;
+
+    AUDIO_TRACE(AUDIO_TRACE_ROUTE_BEGIN, out_device);
+    /* paths missing from the mixer paths file were left negative by
+     * adev_open() */
+    if (speaker_on && adev->route_path[ROUTE_SPEAKER] >= 0)
+        path[num_paths++] = adev->route_path[ROUTE_SPEAKER];
+    if (headphone_on && adev->route_path[ROUTE_HEADPHONE] >= 0)
+        path[num_paths++] = adev->route_path[ROUTE_HEADPHONE];
+    if (docked && adev->route_path[ROUTE_DOCK] >= 0)
+        path[num_paths++] = adev->route_path[ROUTE_DOCK];
+    if (main_mic_on && adev->route_path[ROUTE_MIC] >= 0)
+        path[num_paths++] = adev->route_path[ROUTE_MIC];
+
+    audio_route_apply_paths(adev->ar, path, num_paths);
+    AUDIO_TRACE(AUDIO_TRACE_ROUTE_END, in_device);
+
+    ALOGV("hp=%c speaker=%c dock=%c main-mic=%c", headphone_on ? 'y' : 'n',
+          speaker_on ? 'y' : 'n', docked ? 'y' : 'n', main_mic_on ? 'y' : 'n');
+}
 
-    reset_mixer_state(adev->ar);
+static void *route_thread_loop(void *context)
+{
+    struct audio_device *adev = (struct audio_device *)context;
+    unsigned int out_device;
+    unsigned int in_device;
 
-ALOGE("speaker_on %d headphone_on %d\n", speaker_on, headphone_on);
-    if (speaker_on)
-        audio_route_apply_path(adev->ar, "speaker");
-    if (headphone_on)
-        audio_route_apply_path(adev->ar, "headphone");
-    if (docked)
-        audio_route_apply_path(adev->ar, "dock");
-    if (main_mic_on) {
-        audio_route_apply_path(adev->ar, "mic");
+    pthread_mutex_lock(&adev->route_lock);
+    for (;;) {
+        while (!adev->route_pending && !adev->route_exit)
+            pthread_cond_wait(&adev->route_cond, &adev->route_lock);
+        if (adev->route_exit)
+            break;
+
+        out_device = adev->route_out_device;
+        in_device = adev->route_in_device;
+        adev->route_pending = false;
+        pthread_mutex_unlock(&adev->route_lock);
+
+        apply_route(adev, out_device, in_device);
+        /* not at adev_open(), /data may not be mounted yet */
+        audio_route_save_cache(adev->ar);
+
+        pthread_mutex_lock(&adev->route_lock);
     }
+    pthread_mutex_unlock(&adev->route_lock);
 
-    update_mixer_state(adev->ar);
+    return NULL;
+}
 
-    ALOGV("hp=%c speaker=%c dock=%c main-mic=%c", headphone_on ? 'y' : 'n',
-          speaker_on ? 'y' : 'n', docked ? 'y' : 'n', main_mic_on ? 'y' : 'n');
+/* must be called with hw device mutex locked, queues the current devices
+ * for the routing thread and returns without touching the mixer */
+static void select_devices(struct audio_device *adev)
+{
+    AUDIO_TRACE_LOCK(&adev->route_lock, AUDIO_TRACE_LOCK_ROUTE);
+    adev->route_out_device = adev->out_device;
+    adev->route_in_device = adev->in_device;
+    adev->route_pending = true;
+    pthread_cond_signal(&adev->route_cond);
+    pthread_mutex_unlock(&adev->route_lock);
+}
+
+/* opens the PCM with mmap access if *mmap is set, clearing it and falling
+ * back to read/write access when the driver cannot mmap the PCM */
+static struct pcm *open_pcm(unsigned int device, unsigned int flags,
+                            struct pcm_config *config, bool *mmap)
+{
+    struct pcm *pcm;
+
+    AUDIO_TRACE(AUDIO_TRACE_PCM_OPEN, device);
+    if (*mmap) {
+        pcm = pcm_open(PCM_CARD, device, flags | PCM_MMAP, config);
+        if (pcm && pcm_is_ready(pcm))
+            return pcm;
+
+        ALOGW("mmap of PCM %u failed, using read/write: %s", device,
+              pcm ? pcm_get_error(pcm) : "");
+        if (pcm)
+            pcm_close(pcm);
+        *mmap = false;
+    }
+
+    return pcm_open(PCM_CARD, device, flags, config);
+}
+
+static bool pcm_rate_in_group_11025(unsigned int rate)
+{
+    return rate % 11025 == 0;
+}
+
+/* returns the rate to open a main PCM at for a stream at rate: the rate of
+ * its own group, or of the group of other, the config of the PCM open in
+ * the other direction, if any */
+static unsigned int pcm_get_rate(unsigned int rate,
+                                 const struct pcm_config *other)
+{
+    if (other)
+        rate = other->rate;
+
+    return pcm_rate_in_group_11025(rate) ? PCM_SAMPLING_RATE_11025 :
+            PCM_SAMPLING_RATE_8000;
+}
+
+static bool pcm_rates_share_group(unsigned int a, unsigned int b)
+{
+    return pcm_rate_in_group_11025(a) == pcm_rate_in_group_11025(b);
 }
 
 /* must be called with hw device and output stream mutexes locked */
@@ -211,6 +923,11 @@ static void do_out_standby(struct stream_out *out)
     struct audio_device *adev = out->dev;
 
     if (!out->standby) {
+        stats_begin(&out->stats);
+        out->stats.standbys++;
+        out->position.time_ns = 0;
+        stats_end(&out->stats);
+        AUDIO_TRACE(AUDIO_TRACE_PCM_CLOSE, 0);
         pcm_close(out->pcm);
         out->pcm = NULL;
         adev->active_out = NULL;
@@ -232,9 +949,14 @@ static void do_in_standby(struct stream_in *in)
     struct audio_device *adev = in->dev;
 
     if (!in->standby) {
+        stats_begin(&in->stats);
+        in->stats.standbys++;
+        stats_end(&in->stats);
+        AUDIO_TRACE(AUDIO_TRACE_PCM_CLOSE, 1);
         pcm_close(in->pcm);
         in->pcm = NULL;
         adev->active_in = NULL;
+        publish_stream_state(adev);
         if (in->resampler) {
             release_resampler(in->resampler);
             in->resampler = NULL;
@@ -251,9 +973,19 @@ static void do_in_standby(struct stream_in *in)
 static int start_output_stream(struct stream_out *out)
 {
     struct audio_device *adev = out->dev;
+    struct stream_in *in = adev->active_in;
+    unsigned int rate = out_get_sample_rate(&out->stream.common);
     unsigned int device;
     int ret;
 
+    /* the codec has a single playback front-end: the primary and fast
+     * outputs take turns on it, the other one failing to leave standby */
+    if (adev->active_out && adev->active_out != out) {
+        ALOGV("output %p busy playing, output %p not started",
+              adev->active_out, out);
+        return -EBUSY;
+    }
+
     /*
      * Due to the lack of sample rate converters in the SoC,
      * it greatly simplifies things to have only the main
@@ -265,33 +997,34 @@ static int start_output_stream(struct stream_out *out)
         out->pcm_config = &pcm_config_sco;
     } else {
         device = PCM_DEVICE;
-        out->pcm_config = &pcm_config_out;
+        out->config = *out->default_config;
+        out->config.rate = pcm_get_rate(rate, in ? in->pcm_config : NULL);
+        out->pcm_config = &out->config;
         out->buffer_type = OUT_BUFFER_TYPE_UNKNOWN;
     }
 
-    /*
-     * All open PCMs can only use a single group of rates at once:
-     * Group 1: 11.025, 22.05, 44.1
-     * Group 2: 8, 16, 32, 48
-     * Group 1 is used for digital audio playback since 44.1 is
-     * the most common rate, but group 2 is required for SCO.
-     */
-    if (adev->active_in) {
-        struct stream_in *in = adev->active_in;
+    /* only SCO, fixed in group 2, can conflict with the input PCM. The
+     * input is active, so its capture thread needs no hw device mutex to
+     * pause */
+    if (in && !pcm_rates_share_group(out->pcm_config->rate,
+                                     in->pcm_config->rate)) {
+        if (in->decoupled)
+            in_pause_capture(in);
         pthread_mutex_lock(&in->lock);
-        if (((out->pcm_config->rate % 8000 == 0) &&
-                 (in->pcm_config->rate % 8000) != 0) ||
-                 ((out->pcm_config->rate % 11025 == 0) &&
-                 (in->pcm_config->rate % 11025) != 0))
-            do_in_standby(in);
+        do_in_standby(in);
         pthread_mutex_unlock(&in->lock);
+        if (in->decoupled)
+            in_resume_capture(in);
     }
 
-    out->pcm = pcm_open(PCM_CARD, device, PCM_OUT | PCM_NORESTART, out->pcm_config);
+    out->mmap = out->mmap_requested;
+    out->pcm_started = false;
+    out->pcm = open_pcm(device, OUT_PCM_FLAGS, out->pcm_config, &out->mmap);
 
     if (out->pcm && !pcm_is_ready(out->pcm)) {
         ALOGE("pcm_open(out) failed: %s", pcm_get_error(out->pcm));
         pcm_close(out->pcm);
+        out->pcm = NULL;
         return -ENOMEM;
     }
 
@@ -299,17 +1032,22 @@ static int start_output_stream(struct stream_out *out)
      * If the stream rate differs from the PCM rate, we need to
      * create a resampler.
      */
-    if (out_get_sample_rate(&out->stream.common) != out->pcm_config->rate) {
-        ret = create_resampler(out_get_sample_rate(&out->stream.common),
+    if (rate != out->pcm_config->rate) {
+        ret = create_resampler(rate,
                                out->pcm_config->rate,
                                out->pcm_config->channels,
-                               RESAMPLER_QUALITY_DEFAULT,
+                               out->resampler_quality,
                                NULL,
                                &out->resampler);
-        out->buffer_frames = (pcm_config_out.period_size * out->pcm_config->rate) /
-                out_get_sample_rate(&out->stream.common) + 1;
-
-        out->buffer = malloc(pcm_frames_to_bytes(out->pcm, out->buffer_frames));
+        /* what one stream buffer resamples to */
+        out->buffer_frames = (out_get_buffer_size(&out->stream.common) /
+                audio_stream_frame_size(&out->stream.common)) *
+                out->pcm_config->rate / rate + 1;
+
+        /* the mmap transport resamples straight into the DMA ring */
+        if (!out->mmap)
+            out->buffer = malloc(pcm_frames_to_bytes(out->pcm,
+                                                     out->buffer_frames));
     }
 
     adev->active_out = out;
@@ -321,7 +1059,9 @@ static int start_output_stream(struct stream_out *out)
 static int start_input_stream(struct stream_in *in)
 {
     struct audio_device *adev = in->dev;
+    struct stream_out *out = adev->active_out;
     unsigned int device;
+    unsigned int channels;
     int ret;
 
     /*
@@ -334,35 +1074,43 @@ static int start_input_stream(struct stream_in *in)
         in->pcm_config = &pcm_config_sco;
     } else {
         device = PCM_DEVICE;
-        in->pcm_config = &pcm_config_in;
+        in->config = pcm_config_in;
+        in->config.rate = pcm_get_rate(in_get_sample_rate(&in->stream.common),
+                                       out ? out->pcm_config : NULL);
+        in->pcm_config = &in->config;
+        get_input_downmix(adev->in_device, &in->downmix);
     }
 
-    /*
-     * All open PCMs can only use a single group of rates at once:
-     * Group 1: 11.025, 22.05, 44.1
-     * Group 2: 8, 16, 32, 48
-     * Group 1 is used for digital audio playback since 44.1 is
-     * the most common rate, but group 2 is required for SCO.
-     */
-    if (adev->active_out) {
-        struct stream_out *out = adev->active_out;
+    /* only SCO, fixed in group 2, can conflict with the output PCM */
+    if (out && !pcm_rates_share_group(in->pcm_config->rate,
+                                      out->pcm_config->rate)) {
         pthread_mutex_lock(&out->lock);
-        if (((in->pcm_config->rate % 8000 == 0) &&
-                 (out->pcm_config->rate % 8000) != 0) ||
-                 ((in->pcm_config->rate % 11025 == 0) &&
-                 (out->pcm_config->rate % 11025) != 0))
-            do_out_standby(out);
+        do_out_standby(out);
         pthread_mutex_unlock(&out->lock);
     }
 
-    in->pcm = pcm_open(PCM_CARD, device, PCM_IN, in->pcm_config);
+    in->mmap = in->mmap_requested;
+    in->pcm = open_pcm(device, PCM_IN, in->pcm_config, &in->mmap);
 
     if (in->pcm && !pcm_is_ready(in->pcm)) {
         ALOGE("pcm_open(in) failed: %s", pcm_get_error(in->pcm));
         pcm_close(in->pcm);
+        in->pcm = NULL;
         return -ENOMEM;
     }
 
+    /* no read() call starts an mmap capture PCM */
+    in->pcm_started = false;
+    if (in->mmap) {
+        if (pcm_start(in->pcm) != 0) {
+            ALOGE("pcm_start(in) failed: %s", pcm_get_error(in->pcm));
+            pcm_close(in->pcm);
+            in->pcm = NULL;
+            return -ENOMEM;
+        }
+        in->pcm_started = true;
+    }
+
     /*
      * If the stream rate differs from the PCM rate, we need to
      * create a resampler.
@@ -373,17 +1121,84 @@ static int start_input_stream(struct stream_in *in)
 
         ret = create_resampler(in->pcm_config->rate,
                                in_get_sample_rate(&in->stream.common),
-                               1,
-                               RESAMPLER_QUALITY_DEFAULT,
+                               popcount(in->channel_mask),
+                               in->resampler_quality,
                                &in->buf_provider,
                                &in->resampler);
     }
     in->buffer_size = pcm_frames_to_bytes(in->pcm,
                                           in->pcm_config->period_size);
-    in->buffer = malloc(in->buffer_size);
+    /* room for a period once converted to the stream channel count */
+    channels = popcount(in->channel_mask);
+    if (channels < in->pcm_config->channels)
+        channels = in->pcm_config->channels;
+    in->buffer = malloc(in->pcm_config->period_size * channels *
+                        sizeof(int16_t));
     in->frames_in = 0;
 
     adev->active_in = in;
+    publish_stream_state(adev);
+
+    return 0;
+}
+
+/* must be called with input stream mutex locked. Reads frames straight
+ * from the mapped DMA ring into dst, converted to the stream channel count.
+ * Overruns restart the PCM and are not reported, as in pcm_read() */
+static int in_read_mmap(struct stream_in *in, int16_t *dst, size_t frames)
+{
+    unsigned int channels = popcount(in->channel_mask);
+    unsigned int pcm_channels = in->pcm_config->channels;
+    unsigned int buffer_size = pcm_get_buffer_size(in->pcm);
+    int timeout_ms = buffer_size * 1000 / in->pcm_config->rate + 1;
+    int ret;
+
+    while (frames > 0) {
+        void *areas;
+        unsigned int offset;
+        unsigned int count;
+        const int16_t *src;
+        int avail;
+
+        avail = pcm_mmap_avail(in->pcm);
+        if (avail < 0 || (unsigned int)avail > buffer_size) {
+            stats_begin(&in->stats);
+            in->stats.xruns++;
+            stats_end(&in->stats);
+            AUDIO_TRACE(AUDIO_TRACE_XRUN, 1);
+            pcm_prepare(in->pcm);
+            ret = pcm_start(in->pcm);
+            if (ret != 0)
+                return ret;
+            continue;
+        }
+        if (avail == 0) {
+            AUDIO_TRACE(AUDIO_TRACE_PCM_WAIT_BEGIN, timeout_ms);
+            ret = pcm_wait(in->pcm, timeout_ms);
+            AUDIO_TRACE(AUDIO_TRACE_PCM_WAIT_END, ret);
+            if (ret < 0)
+                return ret;
+            if (ret == 0)
+                return -ETIMEDOUT;
+            continue;
+        }
+
+        count = frames;
+        ret = pcm_mmap_begin(in->pcm, &areas, &offset, &count);
+        if (ret < 0)
+            return ret;
+        src = (const int16_t *)areas + offset * pcm_channels;
+        if (pcm_channels != channels)
+            in_adapt_channels(in, dst, src, count);
+        else
+            memcpy(dst, src, count * channels * sizeof(int16_t));
+        ret = pcm_mmap_commit(in->pcm, offset, count);
+        if (ret < 0)
+            return ret;
+
+        dst += count * channels;
+        frames -= count;
+    }
 
     return 0;
 }
@@ -407,9 +1222,23 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
     }
 
     if (in->frames_in == 0) {
-        in->read_status = pcm_read(in->pcm,
-                                   (void*)in->buffer,
-                                   in->buffer_size);
+        unsigned int channels = popcount(in->channel_mask);
+        int16_t *read_buffer = in->buffer;
+
+        /* a mono PCM is read into the second half of a stereo stream
+         * buffer, to be upmixed in place */
+        if (in->pcm_config->channels < channels && !in->mmap)
+            read_buffer += in->pcm_config->period_size;
+
+        AUDIO_TRACE(AUDIO_TRACE_PCM_READ_BEGIN, in->pcm_config->period_size);
+        if (in->mmap)
+            in->read_status = in_read_mmap(in, in->buffer,
+                                           in->pcm_config->period_size);
+        else
+            in->read_status = pcm_read(in->pcm,
+                                       (void*)read_buffer,
+                                       in->buffer_size);
+        AUDIO_TRACE(AUDIO_TRACE_PCM_READ_END, in->read_status);
         if (in->read_status != 0) {
             ALOGE("get_next_buffer() pcm_read error %d", in->read_status);
             buffer->raw = NULL;
@@ -417,18 +1246,14 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
             return in->read_status;
         }
         in->frames_in = in->pcm_config->period_size;
-        if (in->pcm_config->channels == 2) {
-            unsigned int i;
-
-            /* Discard right channel */
-            for (i = 1; i < in->frames_in; i++)
-                in->buffer[i] = in->buffer[i * 2];
-        }
+        if (in->pcm_config->channels != channels && !in->mmap)
+            in_adapt_channels(in, in->buffer, read_buffer, in->frames_in);
     }
 
     buffer->frame_count = (buffer->frame_count > in->frames_in) ?
                                 in->frames_in : buffer->frame_count;
-    buffer->i16 = in->buffer + (in->pcm_config->period_size - in->frames_in);
+    buffer->i16 = in->buffer + (in->pcm_config->period_size - in->frames_in) *
+                                popcount(in->channel_mask);
 
     return in->read_status;
 
@@ -449,38 +1274,65 @@ static void release_buffer(struct resampler_buffer_provider *buffer_provider,
 }
 
 /* read_frames() reads frames from kernel driver, down samples to capture rate
- * if necessary and output the number of frames requested to the buffer specified */
+ * if necessary and output the number of frames requested to the buffer specified.
+ * Without resampling, frames are read straight into the buffer unless the stereo
+ * PCM has to be mixed down, which is staged in in->buffer one period at a time.
+ * The mmap transport mixes down straight from the DMA ring */
 static ssize_t read_frames(struct stream_in *in, void *buffer, ssize_t frames)
 {
+    size_t frame_size = audio_stream_frame_size(&in->stream.common);
+    unsigned int channels = popcount(in->channel_mask);
     ssize_t frames_wr = 0;
 
     while (frames_wr < frames) {
         size_t frames_rd = frames - frames_wr;
+        int16_t *dst = (int16_t *)((char *)buffer + frames_wr * frame_size);
+        bool copied = false;
+
         if (in->resampler != NULL) {
-            in->resampler->resample_from_provider(in->resampler,
-                    (int16_t *)((char *)buffer +
-                            frames_wr * audio_stream_frame_size(&in->stream.common)),
-                    &frames_rd);
+            in->resampler->resample_from_provider(in->resampler, dst,
+                                                  &frames_rd);
+            copied = true;
+        } else if (in->mmap) {
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_BEGIN, frames_rd);
+            in->read_status = in_read_mmap(in, dst, frames_rd);
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_END, in->read_status);
+        } else if (in->pcm_config->channels > channels) {
+            if (frames_rd > in->pcm_config->period_size)
+                frames_rd = in->pcm_config->period_size;
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_BEGIN, frames_rd);
+            in->read_status = pcm_read(in->pcm, in->buffer,
+                                       pcm_frames_to_bytes(in->pcm, frames_rd));
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_END, in->read_status);
+            if (in->read_status == 0)
+                in_adapt_channels(in, dst, in->buffer, frames_rd);
+            copied = true;
         } else {
-            struct resampler_buffer buf = {
-                    { raw : NULL, },
-                    frame_count : frames_rd,
-            };
-            get_next_buffer(&in->buf_provider, &buf);
-            if (buf.raw != NULL) {
-                memcpy((char *)buffer +
-                           frames_wr * audio_stream_frame_size(&in->stream.common),
-                        buf.raw,
-                        buf.frame_count * audio_stream_frame_size(&in->stream.common));
-                frames_rd = buf.frame_count;
-            }
-            release_buffer(&in->buf_provider, &buf);
+            int16_t *read_buffer = dst;
+
+            /* upmix the mono PCM in place, from the second half of dst */
+            if (in->pcm_config->channels < channels)
+                read_buffer += frames_rd;
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_BEGIN, frames_rd);
+            in->read_status = pcm_read(in->pcm, read_buffer,
+                                       pcm_frames_to_bytes(in->pcm, frames_rd));
+            AUDIO_TRACE(AUDIO_TRACE_PCM_READ_END, in->read_status);
+            if (in->read_status == 0 && read_buffer != dst)
+                in_adapt_channels(in, dst, read_buffer, frames_rd);
         }
         /* in->read_status is updated by getNextBuffer() also called by
          * in->resampler->resample_from_provider() */
         if (in->read_status != 0)
             return in->read_status;
 
+        stats_begin(&in->stats);
+        in->stats.frames += frames_rd;
+        if (in->resampler != NULL)
+            in->stats.resampled_frames += frames_rd;
+        if (copied)
+            in->stats.copied_frames += frames_rd;
+        stats_end(&in->stats);
+
         frames_wr += frames_rd;
     }
     return frames_wr;
@@ -490,7 +1342,7 @@ static ssize_t read_frames(struct stream_in *in, void *buffer, ssize_t frames)
 
 static uint32_t out_get_sample_rate(const struct audio_stream *stream)
 {
-    return pcm_config_out.rate;
+    return OUT_SAMPLING_RATE;
 }
 
 static int out_set_sample_rate(struct audio_stream *stream, uint32_t rate)
@@ -500,8 +1352,19 @@ static int out_set_sample_rate(struct audio_stream *stream, uint32_t rate)
 
 static size_t out_get_buffer_size(const struct audio_stream *stream)
 {
-    return pcm_config_out.period_size *
-               audio_stream_frame_size((struct audio_stream *)stream);
+    struct stream_out *out = (struct stream_out *)stream;
+    size_t size;
+
+    /*
+     * take resampling into account and return the closest minoring
+     * multiple of 16 frames, so that one buffer never exceeds a period
+     * once resampled
+     */
+    size = (out->default_config->period_size * out_get_sample_rate(stream)) /
+            out->default_config->rate;
+    size = (size / 16) * 16;
+
+    return size * audio_stream_frame_size((struct audio_stream *)stream);
 }
 
 static uint32_t out_get_channels(const struct audio_stream *stream)
@@ -523,6 +1386,14 @@ static int out_standby(struct audio_stream *stream)
 {
     struct stream_out *out = (struct stream_out *)stream;
 
+    /* play what is queued before stopping */
+    if (out->decoupled) {
+        pthread_mutex_lock(&out->writer_lock);
+        while (out->writer_busy || audio_ring_filled(&out->ring) > 0)
+            pthread_cond_wait(&out->space_cond, &out->writer_lock);
+        pthread_mutex_unlock(&out->writer_lock);
+    }
+
     pthread_mutex_lock(&out->dev->lock);
     pthread_mutex_lock(&out->lock);
     do_out_standby(out);
@@ -534,6 +1405,29 @@ static int out_standby(struct audio_stream *stream)
 
 static int out_dump(const struct audio_stream *stream, int fd)
 {
+    struct stream_out *out = (struct stream_out *)stream;
+    char buffer[256];
+    int len;
+
+    /* no lock: the configuration does not change once the stream is open,
+     * and a dump must not wait for a blocked out_write() */
+    len = snprintf(buffer, sizeof(buffer),
+                   "  output flags 0x%x: period %u x %u frames at %u Hz, %s\n",
+                   out->flags, out->default_config->period_count,
+                   out->default_config->period_size, out->default_config->rate,
+                   out->mmap ? "mmap" : "read/write");
+
+    if (out->decoupled && len < (int)sizeof(buffer))
+        len += snprintf(buffer + len, sizeof(buffer) - len,
+                        "  writer thread ring: %u of %u frames\n",
+                        (unsigned int)audio_ring_filled(&out->ring),
+                        out->ring.size);
+
+    if (len > (int)sizeof(buffer) - 1)
+        len = sizeof(buffer) - 1;
+    write(fd, buffer, len);
+    dump_stream_stats(fd, &out->stats);
+
     return 0;
 }
 
@@ -544,6 +1438,7 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
     struct str_parms *parms;
     char value[32];
     int ret;
+    int quality_ret;
     unsigned int val;
 
     parms = str_parms_create_str(kvpairs);
@@ -553,7 +1448,7 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
     pthread_mutex_lock(&adev->lock);
     if (ret >= 0) {
         val = atoi(value);
-ALOGE("adev->out_device %x val %x\n", adev->out_device, val);
+        AUDIO_TRACE(AUDIO_TRACE_ROUTING, val);
         if ((adev->out_device != val) && (val != 0)) {
             /*
              * If SCO is turned on/off, we need to put audio into standby
@@ -567,12 +1462,15 @@ ALOGE("adev->out_device %x val %x\n", adev->out_device, val);
             }
 
             adev->out_device = val;
+            publish_stream_state(adev);
             select_devices(adev);
         }
     }
-else
-ALOGE("str_parms_get_str failed %d\n", ret);
+    quality_ret = set_resampler_quality_parameter(parms,
+                                                  &out->resampler_quality);
     pthread_mutex_unlock(&adev->lock);
+    if (quality_ret != -ENOENT)
+        ret = quality_ret;
 
     str_parms_destroy(parms);
     return ret;
@@ -580,7 +1478,25 @@ ALOGE("str_parms_get_str failed %d\n", ret);
 
 static char * out_get_parameters(const struct audio_stream *stream, const char *keys)
 {
-    return strdup("");
+    struct stream_out *out = (struct stream_out *)stream;
+    int quality;
+
+    pthread_mutex_lock(&out->dev->lock);
+    quality = out->resampler_quality;
+    pthread_mutex_unlock(&out->dev->lock);
+
+    return get_stream_parameters(keys, quality, &out->stats);
+}
+
+/* number of periods out_write() lets the kernel buffer fill up to */
+static size_t out_get_period_count(struct stream_out *out, int buffer_type)
+{
+    switch (buffer_type) {
+    case OUT_BUFFER_TYPE_LONG:
+        return OUT_LONG_PERIOD_COUNT;
+    default:
+        return OUT_SHORT_PERIOD_COUNT;
+    }
 }
 
 static uint32_t out_get_latency(const struct audio_stream_out *stream)
@@ -588,17 +1504,23 @@ static uint32_t out_get_latency(const struct audio_stream_out *stream)
     struct stream_out *out = (struct stream_out *)stream;
     struct audio_device *adev = out->dev;
     size_t period_count;
+    uint32_t latency_ms = 0;
+    int32_t state = android_atomic_acquire_load(&adev->stream_state);
 
-    pthread_mutex_lock(&adev->lock);
-
-    if (adev->screen_off && !adev->active_in && !(adev->out_device & AUDIO_DEVICE_OUT_ALL_SCO))
+    if (state == STREAM_STATE_SCREEN_OFF &&
+            !(out->flags & AUDIO_OUTPUT_FLAG_FAST))
         period_count = OUT_LONG_PERIOD_COUNT;
     else
         period_count = OUT_SHORT_PERIOD_COUNT;
 
-    pthread_mutex_unlock(&adev->lock);
+    /* a full ring is queued ahead of the PCM */
+    if (out->decoupled)
+        latency_ms = out->ring.size * 1000 /
+                out_get_sample_rate(&stream->common);
 
-    return (pcm_config_out.period_size * period_count * 1000) / pcm_config_out.rate;
+    return latency_ms +
+            (out->default_config->period_size * period_count * 1000) /
+            out->default_config->rate;
 }
 
 static int out_set_volume(struct audio_stream_out *stream, float left,
@@ -607,11 +1529,175 @@ static int out_set_volume(struct audio_stream_out *stream, float left,
     return -ENOSYS;
 }
 
-static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
-                         size_t bytes)
+static int64_t timespec_diff_ns(const struct timespec *a,
+                                const struct timespec *b)
+{
+    return (int64_t)(a->tv_sec - b->tv_sec) * NSEC_PER_SEC +
+            (a->tv_nsec - b->tv_nsec);
+}
+
+static void timespec_add_ns(struct timespec *ts, int64_t ns)
+{
+    ns += ts->tv_nsec;
+    ts->tv_sec += ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/* must be called with out stream mutex locked. Sleeps once, until the
+ * kernel buffer has drained down to out->cur_write_threshold. The deadline
+ * is derived from the time the driver last updated the hw pointer rather
+ * than from the time of the call, so scheduling delays do not accumulate.
+ * Returns the number of frames expected in the kernel buffer on return. */
+static int out_pace_write(struct stream_out *out)
+{
+    struct timespec deadline;
+    struct timespec now;
+    unsigned int avail;
+    unsigned int rate = out->pcm_config->rate;
+    int kernel_frames;
+    int64_t remaining_ns;
+    int64_t sleep_ns;
+
+    if (pcm_get_htimestamp(out->pcm, &avail, &deadline) < 0)
+        return 0;
+    kernel_frames = pcm_get_buffer_size(out->pcm) - avail;
+    if (kernel_frames <= out->cur_write_threshold)
+        return kernel_frames;
+
+    timespec_add_ns(&deadline,
+                    (int64_t)(kernel_frames - out->cur_write_threshold) *
+                            NSEC_PER_SEC / rate);
+    clock_gettime(OUT_PACING_CLOCK, &now);
+    remaining_ns = timespec_diff_ns(&deadline, &now);
+
+    sleep_ns = remaining_ns;
+    if (sleep_ns > MAX_WRITE_SLEEP_US * 1000LL) {
+        ALOGW("out_write() limiting sleep time %lld to %d",
+              (long long)(sleep_ns / 1000), MAX_WRITE_SLEEP_US);
+        sleep_ns = MAX_WRITE_SLEEP_US * 1000LL;
+        deadline = now;
+        timespec_add_ns(&deadline, sleep_ns);
+    }
+
+    if (sleep_ns >= MIN_WRITE_SLEEP_US * 1000LL) {
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_BEGIN, sleep_ns / 1000);
+        while (clock_nanosleep(OUT_PACING_CLOCK, TIMER_ABSTIME,
+                               &deadline, NULL) == EINTR)
+            ;
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_END, 0);
+        stats_begin(&out->stats);
+        stats_add_time(out->stats.sleep_ms, sleep_ns);
+        stats_end(&out->stats);
+    } else {
+        sleep_ns = 0;
+    }
+
+    /* frames left above the threshold once the sleep is over */
+    kernel_frames = out->cur_write_threshold +
+            (int)((remaining_ns - sleep_ns) * rate / NSEC_PER_SEC);
+    return kernel_frames > 0 ? kernel_frames : 0;
+}
+
+/* must be called with output stream mutex locked. Copies or resamples
+ * in_frames frames straight into the mapped DMA ring, waiting for room if
+ * needed, and starts the PCM once start_threshold frames are queued */
+static int out_write_mmap(struct stream_out *out, int16_t *buffer,
+                          size_t in_frames)
+{
+    unsigned int channels = out->pcm_config->channels;
+    unsigned int buffer_size = pcm_get_buffer_size(out->pcm);
+    unsigned int start_threshold = out->pcm_config->start_threshold;
+    int timeout_ms = buffer_size * 1000 / out->pcm_config->rate + 1;
+    int ret;
+
+    if (start_threshold == 0)
+        start_threshold = 1;
+
+    while (in_frames > 0) {
+        void *areas;
+        unsigned int offset;
+        unsigned int count;
+        size_t in_used;
+        size_t out_made;
+        int16_t *dst;
+        int avail;
+
+        avail = pcm_mmap_avail(out->pcm);
+        if (avail < 0 || (unsigned int)avail > buffer_size) {
+            /* underrun: rearm the PCM, the next write starts it again */
+            pcm_prepare(out->pcm);
+            out->pcm_started = false;
+            return -EPIPE;
+        }
+        if (avail == 0) {
+            AUDIO_TRACE(AUDIO_TRACE_PCM_WAIT_BEGIN, timeout_ms);
+            ret = pcm_wait(out->pcm, timeout_ms);
+            AUDIO_TRACE(AUDIO_TRACE_PCM_WAIT_END, ret);
+            if (ret < 0)
+                return ret;
+            if (ret == 0)
+                return -ETIMEDOUT;
+            continue;
+        }
+
+        count = avail;
+        ret = pcm_mmap_begin(out->pcm, &areas, &offset, &count);
+        if (ret < 0)
+            return ret;
+        dst = (int16_t *)areas + offset * channels;
+        if (out->resampler) {
+            in_used = in_frames;
+            out_made = count;
+            out->resampler->resample_from_input(out->resampler,
+                                                buffer, &in_used,
+                                                dst, &out_made);
+        } else {
+            in_used = out_made = (count < in_frames) ? count : in_frames;
+            memcpy(dst, buffer, out_made * channels * sizeof(int16_t));
+        }
+        ret = pcm_mmap_commit(out->pcm, offset, out_made);
+        if (ret < 0)
+            return ret;
+
+        if (!out->pcm_started &&
+                buffer_size - avail + out_made >= start_threshold) {
+            ret = pcm_start(out->pcm);
+            if (ret != 0)
+                return ret;
+            out->pcm_started = true;
+        }
+
+        /* the resampler may keep a few frames in its own history */
+        if (in_used == 0 && out_made == 0)
+            break;
+        buffer += in_used * channels;
+        in_frames -= in_used;
+    }
+
+    return 0;
+}
+
+/* must be called with out stream mutex locked. Returns the number of frames
+ * still queued in the kernel pcm driver buffer and the time at which the
+ * hw pointer was sampled, on OUT_PACING_CLOCK. */
+static int out_get_kernel_frames(struct stream_out *out, struct timespec *ts)
+{
+    unsigned int avail;
+
+    if (out->standby || !out->pcm ||
+            pcm_get_htimestamp(out->pcm, &avail, ts) < 0)
+        return -EINVAL;
+
+    return pcm_get_buffer_size(out->pcm) - avail;
+}
+
+/* writes one buffer of the stream to the PCM: from out_write(), or from
+ * the writer thread in decoupled mode */
+static ssize_t out_write_pcm(struct stream_out *out, void *buffer,
+                             size_t bytes)
 {
     int ret = 0;
-    struct stream_out *out = (struct stream_out *)stream;
+    struct audio_stream_out *stream = &out->stream;
     struct audio_device *adev = out->dev;
     size_t frame_size = audio_stream_frame_size(&out->stream.common);
     int16_t *in_buffer = (int16_t *)buffer;
@@ -620,37 +1706,48 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
     int buffer_type;
     int kernel_frames;
     bool sco_on;
+    int32_t state;
+    int64_t start_ns = stats_now_ns();
+    unsigned int sleep_us = 0;
+    struct timespec queued_ts;
+    int queued_frames = -1;
+
+    AUDIO_TRACE(AUDIO_TRACE_OUT_WRITE_BEGIN, bytes);
 
     /*
-     * acquiring hw device mutex systematically is useful if a low
-     * priority thread is waiting on the output stream mutex - e.g.
-     * executing out_set_parameters() while holding the hw device
-     * mutex
-     */
-    pthread_mutex_lock(&adev->lock);
-    pthread_mutex_lock(&out->lock);
+     * the hw device mutex is only needed to leave standby, the rest of
+     * the device state comes from adev->stream_state
+     */
+    AUDIO_TRACE_LOCK(&out->lock, AUDIO_TRACE_LOCK_OUT);
     if (out->standby) {
-        ret = start_output_stream(out);
-        if (ret != 0) {
-            pthread_mutex_unlock(&adev->lock);
-            goto exit;
+        pthread_mutex_unlock(&out->lock);
+        AUDIO_TRACE_LOCK(&adev->lock, AUDIO_TRACE_LOCK_DEVICE);
+        pthread_mutex_lock(&out->lock);
+        if (out->standby) {
+            ret = start_output_stream(out);
+            if (ret != 0) {
+                pthread_mutex_unlock(&adev->lock);
+                goto exit;
+            }
+            out->standby = false;
+            stats_begin(&out->stats);
+            out->position.frames_since_standby = 0;
+            stats_end(&out->stats);
         }
-        out->standby = false;
+        pthread_mutex_unlock(&adev->lock);
     }
-    buffer_type = (adev->screen_off && !adev->active_in) ?
+    state = android_atomic_acquire_load(&adev->stream_state);
+    /* the low latency output never switches to long buffers */
+    buffer_type = ((state & STREAM_STATE_SCREEN_OFF) &&
+                   !(state & STREAM_STATE_INPUT_ACTIVE) &&
+                   !(out->flags & AUDIO_OUTPUT_FLAG_FAST)) ?
             OUT_BUFFER_TYPE_LONG : OUT_BUFFER_TYPE_SHORT;
-    sco_on = (adev->out_device & AUDIO_DEVICE_OUT_ALL_SCO);
-    pthread_mutex_unlock(&adev->lock);
+    sco_on = (state & STREAM_STATE_OUT_SCO);
 
     /* detect changes in screen ON/OFF state and adapt buffer size
      * if needed. Do not change buffer size when routed to SCO device. */
     if (!sco_on && (buffer_type != out->buffer_type)) {
-        size_t period_count;
-
-        if (buffer_type == OUT_BUFFER_TYPE_LONG)
-            period_count = OUT_LONG_PERIOD_COUNT;
-        else
-            period_count = OUT_SHORT_PERIOD_COUNT;
+        size_t period_count = out_get_period_count(out, buffer_type);
 
         out->write_threshold = out->pcm_config->period_size * period_count;
         /* reset current threshold if exiting standby */
@@ -662,59 +1759,19 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
     /* Reduce number of channels, if necessary */
     if (popcount(out_get_channels(&stream->common)) >
                  (int)out->pcm_config->channels) {
-        unsigned int i;
-
-        /* Discard right channel */
-        for (i = 1; i < in_frames; i++)
-            in_buffer[i] = in_buffer[i * 2];
+        /* Mix both channels down rather than losing the right one */
+        audio_downmix_s16(in_buffer, in_buffer, in_frames);
 
         /* The frame size is now half */
         frame_size /= 2;
     }
 
-    /* Change sample rate, if necessary */
-    if (out_get_sample_rate(&stream->common) != out->pcm_config->rate) {
-        out_frames = out->buffer_frames;
-        out->resampler->resample_from_input(out->resampler,
-                                            in_buffer, &in_frames,
-                                            out->buffer, &out_frames);
-        in_buffer = out->buffer;
-    } else {
-        out_frames = in_frames;
-    }
-
     if (!sco_on) {
-        int total_sleep_time_us = 0;
         size_t period_size = out->pcm_config->period_size;
 
         /* do not allow more than out->cur_write_threshold frames in kernel
          * pcm driver buffer */
-        do {
-            struct timespec time_stamp;
-            if (pcm_get_htimestamp(out->pcm,
-                                   (unsigned int *)&kernel_frames,
-                                   &time_stamp) < 0)
-                break;
-            kernel_frames = pcm_get_buffer_size(out->pcm) - kernel_frames;
-
-            if (kernel_frames > out->cur_write_threshold) {
-                int sleep_time_us =
-                    (int)(((int64_t)(kernel_frames - out->cur_write_threshold)
-                                    * 1000000) / out->pcm_config->rate);
-                if (sleep_time_us < MIN_WRITE_SLEEP_US)
-                    break;
-                total_sleep_time_us += sleep_time_us;
-                if (total_sleep_time_us > MAX_WRITE_SLEEP_US) {
-                    ALOGW("out_write() limiting sleep time %d to %d",
-                          total_sleep_time_us, MAX_WRITE_SLEEP_US);
-                    sleep_time_us = MAX_WRITE_SLEEP_US -
-                                        (total_sleep_time_us - sleep_time_us);
-                }
-                usleep(sleep_time_us);
-            }
-
-        } while ((kernel_frames > out->cur_write_threshold) &&
-                (total_sleep_time_us <= MAX_WRITE_SLEEP_US));
+        kernel_frames = out_pace_write(out);
 
         /* do not allow abrupt changes on buffer size. Increasing/decreasing
          * the threshold by steps of 1/4th of the buffer size keeps the write
@@ -741,28 +1798,265 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
         }
     }
 
-    ret = pcm_write(out->pcm, in_buffer, out_frames * frame_size);
-    if (ret == -EPIPE) {
-        /* In case of underrun, don't sleep since we want to catch up asap */
-        pthread_mutex_unlock(&out->lock);
-        return ret;
+    AUDIO_TRACE(AUDIO_TRACE_PCM_WRITE_BEGIN, in_frames);
+    if (out->mmap) {
+        /* resampled straight into the DMA ring */
+        ret = out_write_mmap(out, in_buffer, in_frames);
+    } else {
+        /* Change sample rate, if necessary */
+        if (out_get_sample_rate(&stream->common) != out->pcm_config->rate) {
+            out_frames = out->buffer_frames;
+            out->resampler->resample_from_input(out->resampler,
+                                                in_buffer, &in_frames,
+                                                out->buffer, &out_frames);
+            in_buffer = out->buffer;
+        } else {
+            out_frames = in_frames;
+        }
+
+        ret = pcm_write(out->pcm, in_buffer, out_frames * frame_size);
     }
+    AUDIO_TRACE(AUDIO_TRACE_PCM_WRITE_END, ret);
 
 exit:
+    /* In case of underrun, don't sleep since we want to catch up asap */
+    if (ret != 0 && ret != -EPIPE)
+        sleep_us = bytes * 1000000 / audio_stream_frame_size(&stream->common) /
+                out_get_sample_rate(&stream->common);
+
+    /* where the render position is extrapolated from until the next write */
+    if (ret == 0)
+        queued_frames = out_get_kernel_frames(out, &queued_ts);
+
+    stats_begin(&out->stats);
+    if (ret == 0) {
+        out->position.frames_since_standby += bytes /
+                audio_stream_frame_size(&stream->common);
+        if (queued_frames >= 0) {
+            out->position.time_ns = queued_ts.tv_sec * NSEC_PER_SEC +
+                    queued_ts.tv_nsec;
+            out->position.kernel_frames = queued_frames;
+            out->position.pcm_rate = out->pcm_config->rate;
+        }
+        out->stats.frames += bytes / audio_stream_frame_size(&stream->common);
+        if (out->resampler) {
+            out->stats.resampled_frames += bytes /
+                    audio_stream_frame_size(&stream->common);
+            if (!out->mmap)
+                out->stats.copied_frames += bytes /
+                        audio_stream_frame_size(&stream->common);
+        }
+    } else if (ret == -EPIPE) {
+        out->stats.xruns++;
+        AUDIO_TRACE(AUDIO_TRACE_XRUN, 0);
+    }
+    stats_add_time(out->stats.call_ms, stats_now_ns() - start_ns);
+    if (sleep_us)
+        stats_add_time(out->stats.sleep_ms, sleep_us * 1000LL);
+    if (out->decoupled)
+        stats_add_fill(out->stats.ring_fill, out->writer_fill, out->ring.size);
+    stats_end(&out->stats);
+
     pthread_mutex_unlock(&out->lock);
 
-    if (ret != 0) {
-        usleep(bytes * 1000000 / audio_stream_frame_size(&stream->common) /
-               out_get_sample_rate(&stream->common));
+    AUDIO_TRACE(AUDIO_TRACE_OUT_WRITE_END, ret ? ret : (int)bytes);
+    if (ret == -EPIPE)
+        return ret;
+    if (sleep_us) {
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_BEGIN, sleep_us);
+        usleep(sleep_us);
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_END, 0);
+    }
+
+    return bytes;
+}
+
+/* decoupled mode: queues the frames for the writer thread, only waiting
+ * while the ring is full. The copy itself takes no lock, writer_lock is
+ * only held to hand over wakeups */
+static ssize_t out_queue_write(struct stream_out *out, const void *buffer,
+                               size_t bytes)
+{
+    size_t frame_size = audio_stream_frame_size(&out->stream.common);
+    const uint8_t *data = (const uint8_t *)buffer;
+    size_t frames = bytes / frame_size;
+
+    AUDIO_TRACE(AUDIO_TRACE_OUT_WRITE_BEGIN, bytes);
+    while (frames > 0) {
+        size_t written = audio_ring_write(&out->ring, data, frames);
+
+        data += written * frame_size;
+        frames -= written;
+
+        pthread_mutex_lock(&out->writer_lock);
+        if (written)
+            pthread_cond_signal(&out->writer_cond);
+        if (frames > 0 && audio_ring_filled(&out->ring) == out->ring.size) {
+            AUDIO_TRACE(AUDIO_TRACE_SLEEP_BEGIN, 0);
+            pthread_cond_wait(&out->space_cond, &out->writer_lock);
+            AUDIO_TRACE(AUDIO_TRACE_SLEEP_END, 0);
+        }
+        pthread_mutex_unlock(&out->writer_lock);
     }
+    AUDIO_TRACE(AUDIO_TRACE_OUT_WRITE_END, bytes);
 
     return bytes;
 }
 
+static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
+                         size_t bytes)
+{
+    struct stream_out *out = (struct stream_out *)stream;
+
+    if (out->decoupled)
+        return out_queue_write(out, buffer, bytes);
+
+    return out_write_pcm(out, (void *)buffer, bytes);
+}
+
+/* called by the writer and capture threads of the streams */
+static void set_stream_thread_priority(const char *name)
+{
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = STREAM_THREAD_FIFO_PRIORITY;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        ALOGW("%s SCHED_FIFO not permitted, using nice %d", name,
+              STREAM_THREAD_NICE);
+        setpriority(PRIO_PROCESS, gettid(), STREAM_THREAD_NICE);
+    }
+}
+
+/* decoupled mode: drains the ring one stream buffer at a time. Pacing and
+ * PCM error handling are those of out_write_pcm(), which sleeps on a
+ * deadline derived from the hw pointer timestamp */
+static void *out_writer_loop(void *context)
+{
+    struct stream_out *out = (struct stream_out *)context;
+    size_t frame_size = audio_stream_frame_size(&out->stream.common);
+    size_t frames;
+
+    set_stream_thread_priority("out_writer_loop()");
+
+    pthread_mutex_lock(&out->writer_lock);
+    for (;;) {
+        while (!out->writer_exit && audio_ring_filled(&out->ring) == 0)
+            pthread_cond_wait(&out->writer_cond, &out->writer_lock);
+        if (out->writer_exit)
+            break;
+        out->writer_busy = true;
+        pthread_mutex_unlock(&out->writer_lock);
+
+        out->writer_fill = audio_ring_filled(&out->ring);
+        frames = audio_ring_read(&out->ring, out->writer_buffer,
+                                 out->writer_frames);
+        /* let the producer refill while the PCM write blocks */
+        pthread_mutex_lock(&out->writer_lock);
+        pthread_cond_broadcast(&out->space_cond);
+        pthread_mutex_unlock(&out->writer_lock);
+
+        out_write_pcm(out, out->writer_buffer, frames * frame_size);
+
+        pthread_mutex_lock(&out->writer_lock);
+        out->writer_busy = false;
+        pthread_cond_broadcast(&out->space_cond);
+    }
+    pthread_mutex_unlock(&out->writer_lock);
+
+    return NULL;
+}
+
+/* sets up decoupled mode, called before the stream is handed out */
+static int out_start_writer(struct stream_out *out)
+{
+    size_t frame_size = audio_stream_frame_size(&out->stream.common);
+    int ret;
+
+    out->writer_frames = out_get_buffer_size(&out->stream.common) /
+            frame_size;
+    out->writer_buffer = malloc(out->writer_frames * frame_size);
+    if (!out->writer_buffer)
+        return -ENOMEM;
+    ret = audio_ring_init(&out->ring,
+                          out->writer_frames * OUT_RING_BUFFER_COUNT,
+                          frame_size);
+    if (ret != 0)
+        goto err_ring;
+
+    pthread_mutex_init(&out->writer_lock, NULL);
+    pthread_cond_init(&out->writer_cond, NULL);
+    pthread_cond_init(&out->space_cond, NULL);
+    ret = -pthread_create(&out->writer_thread, NULL, out_writer_loop, out);
+    if (ret != 0)
+        goto err_thread;
+
+    out->decoupled = true;
+    return 0;
+
+err_thread:
+    pthread_cond_destroy(&out->space_cond);
+    pthread_cond_destroy(&out->writer_cond);
+    pthread_mutex_destroy(&out->writer_lock);
+    audio_ring_release(&out->ring);
+err_ring:
+    free(out->writer_buffer);
+    out->writer_buffer = NULL;
+    return ret;
+}
+
+static void out_stop_writer(struct stream_out *out)
+{
+    pthread_mutex_lock(&out->writer_lock);
+    out->writer_exit = true;
+    pthread_cond_signal(&out->writer_cond);
+    pthread_mutex_unlock(&out->writer_lock);
+    pthread_join(out->writer_thread, NULL);
+
+    pthread_cond_destroy(&out->space_cond);
+    pthread_cond_destroy(&out->writer_cond);
+    pthread_mutex_destroy(&out->writer_lock);
+    audio_ring_release(&out->ring);
+    free(out->writer_buffer);
+    out->decoupled = false;
+}
+
+/* frames still queued in the PCM at the stream sample rate, extrapolated
+ * from position, which must have a PCM */
+static uint64_t out_get_queued_frames(const struct stream_out *out,
+                                      const struct out_position *position)
+{
+    struct timespec now;
+    int64_t played;
+
+    clock_gettime(OUT_PACING_CLOCK, &now);
+    played = (now.tv_sec * NSEC_PER_SEC + now.tv_nsec - position->time_ns) *
+            position->pcm_rate / NSEC_PER_SEC;
+    if (played >= (int64_t)position->kernel_frames)
+        return 0;
+    if (played < 0)
+        played = 0;
+
+    return (position->kernel_frames - played) *
+            (uint64_t)out_get_sample_rate(&out->stream.common) /
+            position->pcm_rate;
+}
+
 static int out_get_render_position(const struct audio_stream_out *stream,
                                    uint32_t *dsp_frames)
 {
-    return -EINVAL;
+    struct stream_out *out = (struct stream_out *)stream;
+    struct out_position position;
+    uint64_t queued = 0;
+
+    out_get_position(out, &position);
+    if (position.time_ns != 0)
+        queued = out_get_queued_frames(out, &position);
+    if (queued > position.frames_since_standby)
+        queued = position.frames_since_standby;
+    *dsp_frames = (uint32_t)(position.frames_since_standby - queued);
+
+    return 0;
 }
 
 static int out_add_audio_effect(const struct audio_stream *stream, effect_handle_t effect)
@@ -778,7 +2072,36 @@ static int out_remove_audio_effect(const struct audio_stream *stream, effect_han
 static int out_get_next_write_timestamp(const struct audio_stream_out *stream,
                                         int64_t *timestamp)
 {
-    return -EINVAL;
+    struct stream_out *out = (struct stream_out *)stream;
+    struct out_position position;
+    int64_t ns;
+
+    out_get_position(out, &position);
+    if (position.time_ns == 0)
+        return -EINVAL;
+
+    /* the next write is presented once everything queued has played */
+    ns = position.time_ns +
+            (int64_t)position.kernel_frames * NSEC_PER_SEC / position.pcm_rate;
+    if (out->decoupled)
+        ns += (int64_t)audio_ring_filled(&out->ring) * NSEC_PER_SEC /
+                out_get_sample_rate(&stream->common);
+
+#ifndef PCM_MONOTONIC
+    {
+        struct timespec mono;
+        struct timespec real;
+
+        /* the framework expects the local (monotonic) time base */
+        clock_gettime(CLOCK_MONOTONIC, &mono);
+        clock_gettime(OUT_PACING_CLOCK, &real);
+        ns += timespec_diff_ns(&mono, &real);
+    }
+#endif
+
+    *timestamp = ns / 1000;
+
+    return 0;
 }
 
 /** audio_stream_in implementation **/
@@ -802,10 +2125,11 @@ static size_t in_get_buffer_size(const struct audio_stream *stream)
     /*
      * take resampling into account and return the closest majoring
      * multiple of 16 frames, as audioflinger expects audio buffers to
-     * be a multiple of 16 frames
+     * be a multiple of 16 frames. The size does not depend on the rate
+     * the PCM is opened at, see adev_get_input_buffer_size()
      */
-    size = (in->pcm_config->period_size * in_get_sample_rate(stream)) /
-            in->pcm_config->rate;
+    size = (pcm_config_in.period_size * in_get_sample_rate(stream)) /
+            pcm_config_in.rate;
     size = ((size + 15) / 16) * 16;
 
     return size * audio_stream_frame_size((struct audio_stream *)stream);
@@ -813,7 +2137,9 @@ static size_t in_get_buffer_size(const struct audio_stream *stream)
 
 static uint32_t in_get_channels(const struct audio_stream *stream)
 {
-    return AUDIO_CHANNEL_IN_MONO;
+    struct stream_in *in = (struct stream_in *)stream;
+
+    return in->channel_mask;
 }
 
 static audio_format_t in_get_format(const struct audio_stream *stream)
@@ -826,21 +2152,75 @@ static int in_set_format(struct audio_stream *stream, audio_format_t format)
     return -ENOSYS;
 }
 
+/* decoupled mode: stops capturing until in_resume_capture(), leaving the
+ * stream mutex to the caller. What was queued is stale once reading
+ * resumes, and the capture timeline starts over. Must be called without
+ * the hw device mutex, which the capture thread may be waiting for to
+ * leave standby, unless the stream is active */
+static void in_pause_capture(struct stream_in *in)
+{
+    pthread_mutex_lock(&in->capture_lock);
+    in->capture_active = false;
+    in->capture_pauses++;
+    while (in->capture_busy)
+        pthread_cond_wait(&in->data_cond, &in->capture_lock);
+    in->capture_flush = true;
+    in->capture_restarted = true;
+    pthread_mutex_unlock(&in->capture_lock);
+}
+
+/* lets the next in_read(), or one waiting for frames, capture again */
+static void in_resume_capture(struct stream_in *in)
+{
+    pthread_mutex_lock(&in->capture_lock);
+    in->capture_pauses--;
+    pthread_cond_broadcast(&in->data_cond);
+    pthread_mutex_unlock(&in->capture_lock);
+}
+
 static int in_standby(struct audio_stream *stream)
 {
     struct stream_in *in = (struct stream_in *)stream;
 
+    if (in->decoupled)
+        in_pause_capture(in);
+
     pthread_mutex_lock(&in->dev->lock);
     pthread_mutex_lock(&in->lock);
     do_in_standby(in);
     pthread_mutex_unlock(&in->lock);
     pthread_mutex_unlock(&in->dev->lock);
 
+    if (in->decoupled)
+        in_resume_capture(in);
+
     return 0;
 }
 
 static int in_dump(const struct audio_stream *stream, int fd)
 {
+    struct stream_in *in = (struct stream_in *)stream;
+    char buffer[256];
+    int len;
+
+    /* no lock, see out_dump() */
+    len = snprintf(buffer, sizeof(buffer),
+                   "  input channel mask 0x%x at %u Hz, %s\n",
+                   in->channel_mask, in->requested_rate,
+                   in->mmap ? "mmap" : "read/write");
+    if (in->decoupled && len < (int)sizeof(buffer))
+        len += snprintf(buffer + len, sizeof(buffer) - len,
+                        "  capture thread ring: %u of %u frames, "
+                        "%d frames lost\n",
+                        (unsigned int)audio_ring_filled(&in->ring),
+                        in->ring.size,
+                        android_atomic_acquire_load(&in->frames_lost));
+
+    if (len > (int)sizeof(buffer) - 1)
+        len = sizeof(buffer) - 1;
+    write(fd, buffer, len);
+    dump_stream_stats(fd, &in->stats);
+
     return 0;
 }
 
@@ -851,12 +2231,16 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
     struct str_parms *parms;
     char value[32];
     int ret;
+    int quality_ret;
     unsigned int val;
 
     parms = str_parms_create_str(kvpairs);
 
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_STREAM_ROUTING,
                             value, sizeof(value));
+    /* a routing change may need the stream mutex for standby */
+    if (ret >= 0 && in->decoupled)
+        in_pause_capture(in);
     pthread_mutex_lock(&adev->lock);
     if (ret >= 0) {
         val = atoi(value) & ~AUDIO_DEVICE_BIT_IN;
@@ -876,7 +2260,13 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
             select_devices(adev);
         }
     }
+    quality_ret = set_resampler_quality_parameter(parms,
+                                                  &in->resampler_quality);
     pthread_mutex_unlock(&adev->lock);
+    if (ret >= 0 && in->decoupled)
+        in_resume_capture(in);
+    if (quality_ret != -ENOENT)
+        ret = quality_ret;
 
     str_parms_destroy(parms);
     return ret;
@@ -885,7 +2275,14 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
 static char * in_get_parameters(const struct audio_stream *stream,
                                 const char *keys)
 {
-    return strdup("");
+    struct stream_in *in = (struct stream_in *)stream;
+    int quality;
+
+    pthread_mutex_lock(&in->dev->lock);
+    quality = in->resampler_quality;
+    pthread_mutex_unlock(&in->dev->lock);
+
+    return get_stream_parameters(keys, quality, &in->stats);
 }
 
 static int in_set_gain(struct audio_stream_in *stream, float gain)
@@ -893,76 +2290,411 @@ static int in_set_gain(struct audio_stream_in *stream, float gain)
     return 0;
 }
 
-static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
-                       size_t bytes)
+/* must be called with input stream mutex locked. pcm_read() restarts the PCM
+ * after an overrun without reporting it, so look for a full ring, or for a
+ * started PCM the driver has stopped, before reading */
+static bool in_overrun(struct stream_in *in)
+{
+    struct timespec ts;
+    unsigned int avail;
+
+    if (pcm_get_htimestamp(in->pcm, &avail, &ts) < 0)
+        return in->pcm_started;
+
+    return avail >= pcm_get_buffer_size(in->pcm);
+}
+
+/* must be called with input stream mutex locked, after a read. Returns the
+ * CLOCK_MONOTONIC capture time of the last frame read, or 0 */
+static int64_t in_get_capture_end(struct stream_in *in)
+{
+    struct timespec ts;
+    struct timespec mono;
+    struct timespec real;
+    unsigned int avail;
+    int64_t ns;
+
+    if (pcm_get_htimestamp(in->pcm, &avail, &ts) < 0)
+        return 0;
+
+    /* the frames captured since are in the driver, or wait in in->buffer
+     * for the resampler */
+    ns = (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec -
+            (int64_t)(avail + in->frames_in) * NSEC_PER_SEC /
+            in->pcm_config->rate;
+
+    /* input PCMs are stamped on CLOCK_REALTIME */
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    return ns + timespec_diff_ns(&mono, &real);
+}
+
+/* reads one buffer of the stream from the PCM: from in_read(), or from the
+ * capture thread in decoupled mode. Returns 0 or a negative error */
+static int in_read_pcm(struct stream_in *in, void *buffer, size_t bytes)
 {
     int ret = 0;
-    struct stream_in *in = (struct stream_in *)stream;
+    struct audio_stream_in *stream = &in->stream;
     struct audio_device *adev = in->dev;
     size_t frames_rq = bytes / audio_stream_frame_size(&stream->common);
+    int64_t start_ns = stats_now_ns();
+    unsigned int sleep_us = 0;
 
-    /*
-     * acquiring hw device mutex systematically is useful if a low
-     * priority thread is waiting on the input stream mutex - e.g.
-     * executing in_set_parameters() while holding the hw device
-     * mutex
-     */
-    pthread_mutex_lock(&adev->lock);
-    pthread_mutex_lock(&in->lock);
+    AUDIO_TRACE(AUDIO_TRACE_IN_READ_BEGIN, bytes);
+
+    /* the hw device mutex is only needed to leave standby */
+    AUDIO_TRACE_LOCK(&in->lock, AUDIO_TRACE_LOCK_IN);
     if (in->standby) {
-        ret = start_input_stream(in);
-        if (ret == 0)
-            in->standby = 0;
+        pthread_mutex_unlock(&in->lock);
+        AUDIO_TRACE_LOCK(&adev->lock, AUDIO_TRACE_LOCK_DEVICE);
+        pthread_mutex_lock(&in->lock);
+        if (in->standby) {
+            ret = start_input_stream(in);
+            if (ret == 0) {
+                in->standby = 0;
+                in->capture_restarted = true;
+            }
+        }
+        pthread_mutex_unlock(&adev->lock);
     }
-    pthread_mutex_unlock(&adev->lock);
 
     if (ret < 0)
         goto exit;
 
+    if (!in->mmap && in_overrun(in)) {
+        stats_begin(&in->stats);
+        in->stats.xruns++;
+        stats_end(&in->stats);
+        AUDIO_TRACE(AUDIO_TRACE_XRUN, 1);
+    }
+
     /*if (in->num_preprocessors != 0) {
         ret = process_frames(in, buffer, frames_rq);
-    } else */if (in->resampler != NULL) {
-        ret = read_frames(in, buffer, frames_rq);
-    } else if (in->pcm_config->channels == 2) {
-        /*
-         * If the PCM is stereo, capture twice as many frames and
-         * discard the right channel.
-         */
-        unsigned int i;
-        int16_t *in_buffer = (int16_t *)buffer;
+    } else */
+    ret = read_frames(in, buffer, frames_rq);
 
-        ret = pcm_read(in->pcm, in->buffer, bytes * 2);
+    if (ret > 0) {
+        ret = 0;
+        in->pcm_started = true;
+        if (in->decoupled)
+            in->capture_end_ns = in_get_capture_end(in);
+    }
 
-        /* Discard right channel */
-        for (i = 0; i < frames_rq; i++)
-            in_buffer[i] = in->buffer[i * 2];
-    } else {
-        ret = pcm_read(in->pcm, buffer, bytes);
+exit:
+    if (ret < 0)
+        sleep_us = bytes * 1000000 / audio_stream_frame_size(&stream->common) /
+                in_get_sample_rate(&stream->common);
+
+    stats_begin(&in->stats);
+    stats_add_time(in->stats.call_ms, stats_now_ns() - start_ns);
+    if (sleep_us)
+        stats_add_time(in->stats.sleep_ms, sleep_us * 1000LL);
+    if (in->decoupled)
+        stats_add_fill(in->stats.ring_fill, audio_ring_filled(&in->ring),
+                       in->ring.size);
+    stats_end(&in->stats);
+
+    pthread_mutex_unlock(&in->lock);
+
+    AUDIO_TRACE(AUDIO_TRACE_IN_READ_END, ret ? ret : (int)bytes);
+    if (sleep_us) {
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_BEGIN, sleep_us);
+        usleep(sleep_us);
+        AUDIO_TRACE(AUDIO_TRACE_SLEEP_END, 0);
     }
 
-    if (ret > 0)
-        ret = 0;
+    return ret;
+}
+
+/* must be called with capture_lock held. Records the capture time of the
+ * frames queued last, which end at the current rear of the ring */
+static void in_add_capture_anchor(struct stream_in *in, int64_t end_ns)
+{
+    struct capture_anchor *anchor = &in->anchors[in->anchor_next];
+
+    anchor->position = (uint32_t)in->ring.rear;
+    anchor->time_ns = end_ns;
+    in->anchor_next = (in->anchor_next + 1) % in->anchor_count;
+}
+
+/* must be called with capture_lock held. Returns the capture time of the
+ * frame at the front of the ring, from the oldest anchor after it */
+static int64_t in_get_front_time(struct stream_in *in)
+{
+    uint32_t front = (uint32_t)in->ring.front;
+    size_t i;
+
+    for (i = 0; i < in->anchor_count; i++) {
+        struct capture_anchor *anchor =
+                &in->anchors[(in->anchor_next + i) % in->anchor_count];
+        int32_t ahead = (int32_t)(anchor->position - front);
+
+        if (anchor->time_ns != 0 && ahead > 0)
+            return anchor->time_ns - (int64_t)ahead * NSEC_PER_SEC /
+                    in_get_sample_rate(&in->stream.common);
+    }
+
+    return 0;
+}
+
+/* decoupled mode: drops what was queued before in_pause_capture(). Must be
+ * called with capture_lock held, by in_capture_read() only, as the ring
+ * has a single reader. Capturing cannot have started again since the
+ * pause, that too is left to in_capture_read() */
+static void in_flush_capture(struct stream_in *in)
+{
+    if (!in->capture_flush)
+        return;
+    audio_ring_read(&in->ring, NULL, audio_ring_filled(&in->ring));
+    memset(in->anchors, 0, in->anchor_count * sizeof(struct capture_anchor));
+    in->capture_flush = false;
+}
+
+/* decoupled mode: serves the client from the ring, only waiting while it
+ * is empty. The copy takes no lock, capture_lock is held to hand over
+ * wakeups and capture times */
+static ssize_t in_capture_read(struct stream_in *in, void *buffer,
+                               size_t bytes)
+{
+    size_t frame_size = audio_stream_frame_size(&in->stream.common);
+    uint8_t *data = (uint8_t *)buffer;
+    size_t frames = bytes / frame_size;
+    bool first = true;
+
+    AUDIO_TRACE(AUDIO_TRACE_IN_READ_BEGIN, bytes);
+    pthread_mutex_lock(&in->capture_lock);
+    while (frames > 0) {
+        size_t read;
+
+        in_flush_capture(in);
+        while (audio_ring_filled(&in->ring) == 0) {
+            if (!in->capture_active && !in->capture_pauses) {
+                in->capture_active = true;
+                pthread_cond_signal(&in->capture_cond);
+            }
+            AUDIO_TRACE(AUDIO_TRACE_SLEEP_BEGIN, 0);
+            pthread_cond_wait(&in->data_cond, &in->capture_lock);
+            AUDIO_TRACE(AUDIO_TRACE_SLEEP_END, 0);
+            in_flush_capture(in);
+        }
+        if (first) {
+            in->capture_position = in->frames_read;
+            in->capture_time_ns = in_get_front_time(in);
+            first = false;
+        }
+        pthread_mutex_unlock(&in->capture_lock);
+
+        read = audio_ring_read(&in->ring, data, frames);
+        data += read * frame_size;
+        frames -= read;
+
+        pthread_mutex_lock(&in->capture_lock);
+    }
+    in->frames_read += bytes / frame_size;
+    pthread_mutex_unlock(&in->capture_lock);
+    AUDIO_TRACE(AUDIO_TRACE_IN_READ_END, bytes);
+
+    return bytes;
+}
+
+static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
+                       size_t bytes)
+{
+    struct stream_in *in = (struct stream_in *)stream;
+    int ret = 0;
+
+    if (in->decoupled)
+        in_capture_read(in, buffer, bytes);
+    else
+        ret = in_read_pcm(in, buffer, bytes);
 
     /*
      * Instead of writing zeroes here, we could trust the hardware
      * to always provide zeroes when muted.
      */
-    if (ret == 0 && adev->mic_mute)
+    if (ret == 0 && in->dev->mic_mute)
         memset(buffer, 0, bytes);
 
-exit:
-    if (ret < 0)
-        usleep(bytes * 1000000 / audio_stream_frame_size(&stream->common) /
-               in_get_sample_rate(&stream->common));
-
-    pthread_mutex_unlock(&in->lock);
     return bytes;
 }
 
-static uint32_t in_get_input_frames_lost(struct audio_stream_in *stream)
+/* decoupled mode: captures one stream buffer and queues it. Frames that do
+ * not fit in the ring are dropped, as are the frames the PCM lost, found
+ * from the gaps in the capture timeline */
+static void in_capture_buffer(struct stream_in *in, int64_t *last_end_ns)
+{
+    size_t frame_size = audio_stream_frame_size(&in->stream.common);
+    unsigned int rate = in_get_sample_rate(&in->stream.common);
+    int64_t duration_ns = (int64_t)in->capture_frames * NSEC_PER_SEC / rate;
+    int64_t end_ns;
+    size_t written;
+    int32_t lost = 0;
+
+    in->capture_end_ns = 0;
+    if (in_read_pcm(in, in->capture_buffer,
+                    in->capture_frames * frame_size) != 0) {
+        /* in_read_pcm() slept for the duration of the buffer */
+        memset(in->capture_buffer, 0, in->capture_frames * frame_size);
+        in->capture_restarted = true;
+    }
+    end_ns = in->capture_end_ns ? in->capture_end_ns : stats_now_ns();
+
+    if (in->capture_restarted) {
+        in->capture_restarted = false;
+    } else if (*last_end_ns != 0 &&
+            end_ns - *last_end_ns > duration_ns + duration_ns / 2) {
+        lost = (end_ns - *last_end_ns - duration_ns) * rate / NSEC_PER_SEC;
+    }
+    *last_end_ns = end_ns;
+
+    written = audio_ring_write(&in->ring, in->capture_buffer,
+                               in->capture_frames);
+    lost += in->capture_frames - written;
+    if (lost) {
+        AUDIO_TRACE(AUDIO_TRACE_XRUN, 1);
+        android_atomic_add(lost, &in->frames_lost);
+    }
+
+    pthread_mutex_lock(&in->capture_lock);
+    if (written)
+        in_add_capture_anchor(in, end_ns - (int64_t)(in->capture_frames -
+                              written) * NSEC_PER_SEC / rate);
+    pthread_cond_broadcast(&in->data_cond);
+    pthread_mutex_unlock(&in->capture_lock);
+}
+
+static void *in_capture_loop(void *context)
+{
+    struct stream_in *in = (struct stream_in *)context;
+    int64_t last_end_ns = 0;
+
+    set_stream_thread_priority("in_capture_loop()");
+
+    pthread_mutex_lock(&in->capture_lock);
+    for (;;) {
+        while (!in->capture_exit && !in->capture_active)
+            pthread_cond_wait(&in->capture_cond, &in->capture_lock);
+        if (in->capture_exit)
+            break;
+        in->capture_busy = true;
+        pthread_mutex_unlock(&in->capture_lock);
+
+        in_capture_buffer(in, &last_end_ns);
+
+        pthread_mutex_lock(&in->capture_lock);
+        in->capture_busy = false;
+        pthread_cond_broadcast(&in->data_cond);
+    }
+    pthread_mutex_unlock(&in->capture_lock);
+
+    return NULL;
+}
+
+/* sets up decoupled mode, called before the stream is handed out */
+static int in_start_capture(struct stream_in *in)
 {
+    size_t frame_size = audio_stream_frame_size(&in->stream.common);
+    int ret;
+
+    in->capture_frames = in_get_buffer_size(&in->stream.common) / frame_size;
+    in->capture_buffer = malloc(in->capture_frames * frame_size);
+    if (!in->capture_buffer)
+        return -ENOMEM;
+    ret = audio_ring_init(&in->ring,
+                          in->capture_frames * IN_RING_BUFFER_COUNT,
+                          frame_size);
+    if (ret != 0)
+        goto err_ring;
+    /* one anchor per queued buffer, the oldest possibly partly read */
+    in->anchor_count = in->ring.size / in->capture_frames + 2;
+    in->anchors = (struct capture_anchor *)
+            calloc(in->anchor_count, sizeof(struct capture_anchor));
+    if (!in->anchors) {
+        ret = -ENOMEM;
+        goto err_anchors;
+    }
+
+    pthread_mutex_init(&in->capture_lock, NULL);
+    pthread_cond_init(&in->capture_cond, NULL);
+    pthread_cond_init(&in->data_cond, NULL);
+    /* in_read_pcm() looks at it */
+    in->decoupled = true;
+    ret = -pthread_create(&in->capture_thread, NULL, in_capture_loop, in);
+    if (ret != 0)
+        goto err_thread;
+
     return 0;
+
+err_thread:
+    in->decoupled = false;
+    pthread_cond_destroy(&in->data_cond);
+    pthread_cond_destroy(&in->capture_cond);
+    pthread_mutex_destroy(&in->capture_lock);
+    free(in->anchors);
+    in->anchors = NULL;
+err_anchors:
+    audio_ring_release(&in->ring);
+err_ring:
+    free(in->capture_buffer);
+    in->capture_buffer = NULL;
+    return ret;
+}
+
+static void in_stop_capture(struct stream_in *in)
+{
+    pthread_mutex_lock(&in->capture_lock);
+    in->capture_exit = true;
+    pthread_cond_signal(&in->capture_cond);
+    pthread_mutex_unlock(&in->capture_lock);
+    pthread_join(in->capture_thread, NULL);
+
+    pthread_cond_destroy(&in->data_cond);
+    pthread_cond_destroy(&in->capture_cond);
+    pthread_mutex_destroy(&in->capture_lock);
+    free(in->anchors);
+    audio_ring_release(&in->ring);
+    free(in->capture_buffer);
+    in->decoupled = false;
+}
+
+static uint32_t in_get_input_frames_lost(struct audio_stream_in *stream)
+{
+    struct stream_in *in = (struct stream_in *)stream;
+    int32_t lost;
+
+    /* without the capture thread pcm_read() hides what overruns drop */
+    if (!in->decoupled)
+        return 0;
+
+    lost = android_atomic_acquire_load(&in->frames_lost);
+    android_atomic_add(-lost, &in->frames_lost);
+    return lost;
+}
+
+#ifdef AUDIO_HW_CAPTURE_POSITION
+/* decoupled mode: returns the number of frames the client read before the
+ * last in_read(), and the CLOCK_MONOTONIC time at which the first frame
+ * that in_read() returned was captured */
+static int in_get_capture_position(const struct audio_stream_in *stream,
+                                   int64_t *frames, int64_t *time)
+{
+    struct stream_in *in = (struct stream_in *)stream;
+    int ret = -ENOSYS;
+
+    if (!in->decoupled)
+        return -ENOSYS;
+
+    pthread_mutex_lock(&in->capture_lock);
+    if (in->capture_time_ns != 0) {
+        *frames = in->capture_position;
+        *time = in->capture_time_ns;
+        ret = 0;
+    }
+    pthread_mutex_unlock(&in->capture_lock);
+
+    return ret;
 }
+#endif
 
 static int in_add_audio_effect(const struct audio_stream *stream,
                                effect_handle_t effect)
@@ -1011,12 +2743,32 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
     out->stream.get_next_write_timestamp = out_get_next_write_timestamp;
 
     out->dev = adev;
+    out->flags = flags;
+    if (flags & AUDIO_OUTPUT_FLAG_FAST)
+        out->default_config = &pcm_config_out_fast;
+    else
+        out->default_config = &pcm_config_out;
 
     config->format = out_get_format(&out->stream.common);
     config->channel_mask = out_get_channels(&out->stream.common);
     config->sample_rate = out_get_sample_rate(&out->stream.common);
 
     out->standby = true;
+    out->resampler_quality = get_default_resampler_quality();
+    out->mmap_requested = get_bool_property(OUT_MMAP_PROPERTY);
+    out->mmap = out->mmap_requested;
+
+    if (get_bool_property(OUT_WRITER_THREAD_PROPERTY)) {
+        ret = out_start_writer(out);
+        if (ret != 0)
+            ALOGW("Unable to start the output writer thread (%d), "
+                  "writing from out_write()", ret);
+    }
+
+    pthread_mutex_lock(&adev->stream_list_lock);
+    out->next = adev->out_list;
+    adev->out_list = out;
+    pthread_mutex_unlock(&adev->stream_list_lock);
 
     *stream_out = &out->stream;
     return 0;
@@ -1030,7 +2782,22 @@ err_open:
 static void adev_close_output_stream(struct audio_hw_device *dev,
                                      struct audio_stream_out *stream)
 {
+    struct stream_out *out = (struct stream_out *)stream;
+    struct audio_device *adev = (struct audio_device *)dev;
+    struct stream_out **prev;
+
+    pthread_mutex_lock(&adev->stream_list_lock);
+    for (prev = &adev->out_list; *prev; prev = &(*prev)->next) {
+        if (*prev == out) {
+            *prev = out->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&adev->stream_list_lock);
+
     out_standby(&stream->common);
+    if (out->decoupled)
+        out_stop_writer(out);
     free(stream);
 }
 
@@ -1073,10 +2840,13 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
 
     ret = str_parms_get_str(parms, "screen_state", value, sizeof(value));
     if (ret >= 0) {
+        pthread_mutex_lock(&adev->lock);
         if (strcmp(value, AUDIO_PARAMETER_VALUE_ON) == 0)
             adev->screen_off = false;
         else
             adev->screen_off = true;
+        publish_stream_state(adev);
+        pthread_mutex_unlock(&adev->lock);
     }
 
     str_parms_destroy(parms);
@@ -1157,7 +2927,8 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     *stream_in = NULL;
 
     /* Respond with a request for mono if a different format is given. */
-    if (config->channel_mask != AUDIO_CHANNEL_IN_MONO) {
+    if (config->channel_mask != AUDIO_CHANNEL_IN_MONO &&
+            config->channel_mask != AUDIO_CHANNEL_IN_STEREO) {
         config->channel_mask = AUDIO_CHANNEL_IN_MONO;
         return -EINVAL;
     }
@@ -1181,11 +2952,31 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     in->stream.set_gain = in_set_gain;
     in->stream.read = in_read;
     in->stream.get_input_frames_lost = in_get_input_frames_lost;
+#ifdef AUDIO_HW_CAPTURE_POSITION
+    in->stream.get_capture_position = in_get_capture_position;
+#endif
 
     in->dev = adev;
     in->standby = true;
     in->requested_rate = config->sample_rate;
-    in->pcm_config = &pcm_config_in; /* default PCM config */
+    in->channel_mask = config->channel_mask;
+    in->resampler_quality = get_default_resampler_quality();
+    in->mmap_requested = get_bool_property(IN_MMAP_PROPERTY);
+    in->mmap = in->mmap_requested;
+    in->config = pcm_config_in;
+    in->pcm_config = &in->config; /* default PCM config */
+
+    if (get_bool_property(IN_CAPTURE_THREAD_PROPERTY)) {
+        ret = in_start_capture(in);
+        if (ret != 0)
+            ALOGW("Unable to start the input capture thread (%d), "
+                  "reading from in_read()", ret);
+    }
+
+    pthread_mutex_lock(&adev->stream_list_lock);
+    in->next = adev->in_list;
+    adev->in_list = in;
+    pthread_mutex_unlock(&adev->stream_list_lock);
 
     *stream_in = &in->stream;
     return 0;
@@ -1195,13 +2986,77 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
                                    struct audio_stream_in *stream)
 {
     struct stream_in *in = (struct stream_in *)stream;
+    struct audio_device *adev = (struct audio_device *)dev;
+    struct stream_in **prev;
+
+    pthread_mutex_lock(&adev->stream_list_lock);
+    for (prev = &adev->in_list; *prev; prev = &(*prev)->next) {
+        if (*prev == in) {
+            *prev = in->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&adev->stream_list_lock);
 
     in_standby(&stream->common);
+    if (in->decoupled)
+        in_stop_capture(in);
     free(stream);
 }
 
 static int adev_dump(const audio_hw_device_t *device, int fd)
 {
+    struct audio_device *adev = (struct audio_device *)device;
+    struct stream_dump dumps[MAX_DUMPED_STREAMS];
+    unsigned int num_dumps = 0;
+    unsigned int i;
+    struct stream_out *out;
+    struct stream_in *in;
+    char buffer[256];
+    int len;
+
+    /* racy reads, a dump must not wait for routing or a stream open */
+    len = snprintf(buffer, sizeof(buffer),
+                   "audio_hw_primary: out device 0x%x, in device 0x%x, "
+                   "screen %s, mic %s\n",
+                   adev->out_device, adev->in_device,
+                   adev->screen_off ? "off" : "on",
+                   adev->mic_mute ? "muted" : "on");
+    if (len > (int)sizeof(buffer) - 1)
+        len = sizeof(buffer) - 1;
+    write(fd, buffer, len);
+
+    /* the list lock only keeps the streams from being freed while their
+     * stats are copied, they are written out after releasing it */
+    pthread_mutex_lock(&adev->stream_list_lock);
+    for (out = adev->out_list; out && num_dumps < MAX_DUMPED_STREAMS;
+            out = out->next) {
+        dumps[num_dumps].stream = out;
+        dumps[num_dumps].input = false;
+        dumps[num_dumps].standby = out->standby;
+        stats_snapshot(&out->stats, &dumps[num_dumps].stats);
+        num_dumps++;
+    }
+    for (in = adev->in_list; in && num_dumps < MAX_DUMPED_STREAMS;
+            in = in->next) {
+        dumps[num_dumps].stream = in;
+        dumps[num_dumps].input = true;
+        dumps[num_dumps].standby = in->standby;
+        stats_snapshot(&in->stats, &dumps[num_dumps].stats);
+        num_dumps++;
+    }
+    pthread_mutex_unlock(&adev->stream_list_lock);
+
+    for (i = 0; i < num_dumps; i++) {
+        len = snprintf(buffer, sizeof(buffer), " %s %p, %s:\n",
+                       dumps[i].input ? "input" : "output", dumps[i].stream,
+                       dumps[i].standby ? "standby" : "active");
+        write(fd, buffer, len);
+        dump_stream_stats(fd, &dumps[i].stats);
+    }
+
+    AUDIO_TRACE_DUMP(fd);
+
     return 0;
 }
 
@@ -1209,6 +3064,12 @@ static int adev_close(hw_device_t *device)
 {
     struct audio_device *adev = (struct audio_device *)device;
 
+    pthread_mutex_lock(&adev->route_lock);
+    adev->route_exit = true;
+    pthread_cond_signal(&adev->route_cond);
+    pthread_mutex_unlock(&adev->route_lock);
+    pthread_join(adev->route_thread, NULL);
+
     audio_route_free(adev->ar);
 
     free(device);
@@ -1219,6 +3080,7 @@ static int adev_open(const hw_module_t* module, const char* name,
                      hw_device_t** device)
 {
     struct audio_device *adev;
+    unsigned int i;
     int ret;
 
     if (strcmp(name, AUDIO_HARDWARE_INTERFACE) != 0)
@@ -1249,11 +3111,34 @@ static int adev_open(const hw_module_t* module, const char* name,
     adev->hw_device.dump = adev_dump;
 
     adev->ar = audio_route_init();
+    if (!adev->ar) {
+        ALOGE("Unable to load the mixer paths");
+        free(adev);
+        return -ENODEV;
+    }
+    /* resolve the paths once, a missing one is never applied */
+    for (i = 0; i < ROUTE_COUNT; i++) {
+        adev->route_path[i] = audio_route_get_path_handle(adev->ar,
+                                                          route_path_names[i]);
+        if (adev->route_path[i] < 0)
+            ALOGW("No '%s' path, it will not be routed", route_path_names[i]);
+    }
     adev->orientation = ORIENTATION_UNDEFINED;
     /* Let the call to out_set_parameters initialize this */
     adev->out_device = AUDIO_DEVICE_NONE;
     adev->in_device = AUDIO_DEVICE_IN_BUILTIN_MIC & ~AUDIO_DEVICE_BIT_IN;
 
+    pthread_mutex_init(&adev->route_lock, NULL);
+    pthread_cond_init(&adev->route_cond, NULL);
+    pthread_mutex_init(&adev->stream_list_lock, NULL);
+    ret = pthread_create(&adev->route_thread, NULL, route_thread_loop, adev);
+    if (ret != 0) {
+        ALOGE("Unable to create routing thread: %d", ret);
+        audio_route_free(adev->ar);
+        free(adev);
+        return -ret;
+    }
+
     *device = &adev->hw_device.common;
 
     return 0;
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/atomic.h>
+
+#include "audio_ring.h"
+
+/*
+ * Positions count frames since init and wrap around at 2^32, a power of 2
+ * multiple of the ring size, so that (rear - front) is always the number of
+ * frames in the ring and (position & (size - 1)) its index.
+ */
+
+int audio_ring_init(struct audio_ring *ring, size_t frames, size_t frame_size)
+{
+    uint32_t size = 1;
+
+    while (size < frames)
+        size <<= 1;
+
+    ring->data = (uint8_t *)malloc(size * frame_size);
+    if (!ring->data)
+        return -ENOMEM;
+    ring->frame_size = frame_size;
+    ring->size = size;
+    ring->rear = 0;
+    ring->front = 0;
+
+    return 0;
+}
+
+void audio_ring_release(struct audio_ring *ring)
+{
+    free(ring->data);
+    ring->data = NULL;
+}
+
+size_t audio_ring_filled(struct audio_ring *ring)
+{
+    uint32_t front = (uint32_t)android_atomic_acquire_load(&ring->front);
+    uint32_t rear = (uint32_t)android_atomic_acquire_load(&ring->rear);
+
+    return rear - front;
+}
+
+size_t audio_ring_write(struct audio_ring *ring, const void *data,
+                        size_t frames)
+{
+    uint32_t rear = (uint32_t)ring->rear;
+    uint32_t front = (uint32_t)android_atomic_acquire_load(&ring->front);
+    uint32_t index = rear & (ring->size - 1);
+    size_t space = ring->size - (rear - front);
+    size_t first;
+
+    if (frames > space)
+        frames = space;
+    first = ring->size - index;
+    if (first > frames)
+        first = frames;
+
+    memcpy(ring->data + index * ring->frame_size, data,
+           first * ring->frame_size);
+    memcpy(ring->data, (const uint8_t *)data + first * ring->frame_size,
+           (frames - first) * ring->frame_size);
+
+    android_atomic_release_store((int32_t)(rear + frames), &ring->rear);
+    return frames;
+}
+
+size_t audio_ring_read(struct audio_ring *ring, void *data, size_t frames)
+{
+    uint32_t front = (uint32_t)ring->front;
+    uint32_t rear = (uint32_t)android_atomic_acquire_load(&ring->rear);
+    uint32_t index = front & (ring->size - 1);
+    size_t filled = rear - front;
+    size_t first;
+
+    if (frames > filled)
+        frames = filled;
+    first = ring->size - index;
+    if (first > frames)
+        first = frames;
+
+    if (data) {
+        memcpy(data, ring->data + index * ring->frame_size,
+               first * ring->frame_size);
+        memcpy((uint8_t *)data + first * ring->frame_size, ring->data,
+               (frames - first) * ring->frame_size);
+    }
+
+    android_atomic_release_store((int32_t)(front + frames), &ring->front);
+    return frames;
+}
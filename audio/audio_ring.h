@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Lock-free ring of audio frames between one producer thread and one
+   consumer thread. Each side only advances its own position, which it
+   publishes with a release store once the frames are copied. */
+struct audio_ring {
+    uint8_t *data;
+    size_t frame_size;
+    uint32_t size;          /* in frames, a power of 2 */
+    volatile int32_t rear;  /* frames written, advanced by the producer */
+    volatile int32_t front; /* frames read, advanced by the consumer */
+};
+
+/* Allocates room for at least frames frames, returns 0 or -ENOMEM */
+int audio_ring_init(struct audio_ring *ring, size_t frames, size_t frame_size);
+void audio_ring_release(struct audio_ring *ring);
+
+/* Frames in the ring, which either side may call */
+size_t audio_ring_filled(struct audio_ring *ring);
+
+/* Producer side: copies up to frames frames in, returns the number copied */
+size_t audio_ring_write(struct audio_ring *ring, const void *data,
+                        size_t frames);
+
+/* Consumer side: copies up to frames frames out, returns the number copied.
+   A NULL data drops the frames instead */
+size_t audio_ring_read(struct audio_ring *ring, void *data, size_t frames);
+
+#endif
@@ -20,31 +20,72 @@
 
 #include <errno.h>
 #include <expat.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <cutils/log.h>
 
 #include <tinyalsa/asoundlib.h>
 
-#define BUF_SIZE 1024
+#include "audio_trace.h"
+
+/* the tests build with their own paths */
+#ifndef MIXER_XML_PATH
 #define MIXER_XML_PATH "/system/etc/mixer_paths.xml"
+#endif
+#ifndef MIXER_CACHE_PATH
+#define MIXER_CACHE_PATH "/data/misc/audio/mixer_paths.cache"
+#endif
 #define INITIAL_MIXER_PATH_SIZE 8
+#define INITIAL_PATH_HASH_SIZE 32 /* must be a power of 2 */
+#define ARENA_BLOCK_SIZE 4096
+#define ROUTE_COMBO_CACHE_SIZE 4
+#define MAX_COMBO_PATHS 8
 
 #define MIXER_CARD 0
 
+/* largest number of values a single ctl can hold (see snd_ctl_elem_value) */
+#define MAX_CTL_VALUES 128
+
+#define ROUTE_CACHE_MAGIC 0x43545241 /* "ARTC" */
+#define ROUTE_CACHE_VERSION 1
+/* audio_route_save_cache() calls that try to write a missing cache */
+#define ROUTE_CACHE_SAVE_ATTEMPTS 4
+
 struct mixer_state {
     struct mixer_ctl *ctl;
-    int old_value;
-    int new_value;
-    int reset_value;
+    enum mixer_ctl_type type;
+    unsigned int num_values;
+    /* per-value state, each array holds num_values entries */
+    int *old_value;
+    int *new_value;
+    int *reset_value;
+    bool dirty; /* on the dirty list */
 };
 
 struct mixer_setting {
-    struct mixer_ctl *ctl;
+    unsigned int ctl_index; /* index into mixer_state */
     int value;
 };
 
+/* bump allocator for path names and settings, all freed together */
+struct arena_block {
+    struct arena_block *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct arena {
+    struct arena_block *head;
+};
+
 struct mixer_path {
     char *name;
     unsigned int size;
@@ -52,14 +93,90 @@ struct mixer_path {
     struct mixer_setting *setting;
 };
 
+/* the composed settings of a set of paths, cached so that switching back to
+   a recently used combination does not need to compose it again */
+struct route_combo {
+    bool valid;
+    unsigned int num_handles;
+    int handle[MAX_COMBO_PATHS];
+    unsigned int length;
+    struct mixer_setting *setting;
+    unsigned int last_used;
+};
+
+/* identifies the contents of the mixer XML a route cache was compiled from */
+struct route_cache_key {
+    uint64_t xml_mtime;
+    uint64_t xml_size;
+    uint32_t xml_hash;
+    uint32_t ctl_signature; /* hash of the names and types of all ctls */
+};
+
+/*
+ * The compiled route cache is a flat file holding everything the XML parse
+ * produces: a header, a route_cache_path table whose first entry is the
+ * initial settings, the mixer_setting array with resolved ctl indices and
+ * enum values, and finally the NUL terminated path names. It is mapped
+ * read-only and the paths point straight into the mapping.
+ */
+struct route_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    struct route_cache_key key;
+    uint32_t num_ctls;
+    uint32_t num_paths; /* not counting the initial settings */
+    uint32_t num_settings;
+    uint32_t names_size;
+};
+
+struct route_cache_path {
+    uint32_t name_offset;
+    uint32_t first_setting;
+    uint32_t num_settings;
+};
+
 struct audio_route {
     struct mixer *mixer;
     unsigned int num_mixer_ctls;
     struct mixer_state *mixer_state;
+    int *mixer_values; /* backing store for the mixer_state value arrays */
+
+    /* mixer_state indices that may need committing by update_mixer_state() */
+    unsigned int num_dirty_ctls;
+    unsigned int *dirty_ctl;
+
+    /* mixer_state indices referenced by any path, the only ones that can
+       move away from their reset values */
+    unsigned int num_path_ctls;
+    unsigned int *path_ctl;
 
     unsigned int mixer_path_size;
     unsigned int num_mixer_paths;
     struct mixer_path *mixer_path;
+
+    /* open addressed hash of path names, each slot holds a path handle
+       (an index into mixer_path) or -1 if unused */
+    unsigned int path_hash_size;
+    int *path_hash;
+
+    /* settings from the top level <ctl> tags, applied once at init */
+    struct mixer_path initial_path;
+
+    /* holds the names and settings of paths parsed from the XML */
+    struct arena path_arena;
+
+    /* mapping of the route cache the paths were loaded from, if any */
+    void *route_cache;
+    size_t route_cache_size;
+
+    /* the paths were parsed from the XML: audio_route_save_cache() still
+       has route_cache_attempts tries to write them under route_cache_key */
+    struct route_cache_key route_cache_key;
+    unsigned int route_cache_attempts;
+
+    /* recently applied path combinations, see audio_route_apply_paths() */
+    struct route_combo route_combo[ROUTE_COMBO_CACHE_SIZE];
+    unsigned int route_combo_clock;
 };
 
 struct config_parse_state {
@@ -68,31 +185,170 @@ struct config_parse_state {
     int level;
 };
 
+/* arena functions */
+
+static void *arena_alloc(struct arena *arena, size_t size)
+{
+    struct arena_block *block = arena->head;
+    size_t block_size;
+    void *ptr;
+
+    /* keep every allocation suitably aligned for the settings */
+    size = (size + 7) & ~(size_t)7;
+
+    if (!block || (block->size - block->used < size)) {
+        block_size = (size > ARENA_BLOCK_SIZE) ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(struct arena_block) + block_size);
+        if (!block)
+            return NULL;
+        block->next = arena->head;
+        block->size = block_size;
+        block->used = 0;
+        arena->head = block;
+    }
+
+    ptr = block->data + block->used;
+    block->used += size;
+
+    return ptr;
+}
+
+/* grows an allocation, in place if it is the most recent one */
+static void *arena_grow(struct arena *arena, void *ptr, size_t old_size,
+                        size_t new_size)
+{
+    struct arena_block *block = arena->head;
+    void *new_ptr;
+
+    old_size = (old_size + 7) & ~(size_t)7;
+    new_size = (new_size + 7) & ~(size_t)7;
+
+    if (ptr && block && ((char *)ptr + old_size == block->data + block->used) &&
+            (block->size - block->used >= new_size - old_size)) {
+        block->used += new_size - old_size;
+        return ptr;
+    }
+
+    new_ptr = arena_alloc(arena, new_size);
+    if (new_ptr && ptr)
+        memcpy(new_ptr, ptr, old_size);
+
+    return new_ptr;
+}
+
+static char *arena_strdup(struct arena *arena, const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *new_str = arena_alloc(arena, size);
+
+    if (new_str)
+        memcpy(new_str, str, size);
+
+    return new_str;
+}
+
+static void arena_free(struct arena *arena)
+{
+    struct arena_block *block;
+
+    while (arena->head) {
+        block = arena->head;
+        arena->head = block->next;
+        free(block);
+    }
+}
+
 /* path functions */
 
 static void path_free(struct audio_route *ar)
 {
+    /* path names and settings live either in the arena or, for cached
+       paths, in the cache mapping */
+    arena_free(&ar->path_arena);
+    if (ar->route_cache) {
+        munmap(ar->route_cache, ar->route_cache_size);
+        ar->route_cache = NULL;
+    }
+    free(ar->mixer_path);
+    free(ar->path_hash);
+    free(ar->path_ctl);
+}
+
+/* FNV-1a hash, chained from a previous hash value */
+static unsigned int hash_bytes(unsigned int hash, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+
+    while (size--) {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+#define HASH_INIT 2166136261u
+
+static unsigned int path_hash_name(const char *name)
+{
+    return hash_bytes(HASH_INIT, name, strlen(name));
+}
+
+/* returns the hash slot holding the named path, or the empty slot where it
+   would be inserted */
+static unsigned int path_hash_slot(struct audio_route *ar, const char *name)
+{
+    unsigned int mask = ar->path_hash_size - 1;
+    unsigned int slot = path_hash_name(name) & mask;
+
+    while ((ar->path_hash[slot] >= 0) &&
+           (strcmp(ar->mixer_path[ar->path_hash[slot]].name, name) != 0))
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+static int path_hash_resize(struct audio_route *ar, unsigned int size)
+{
+    int *new_path_hash;
     unsigned int i;
 
-    for (i = 0; i < ar->num_mixer_paths; i++) {
-        if (ar->mixer_path[i].name)
-            free(ar->mixer_path[i].name);
-        if (ar->mixer_path[i].setting)
-            free(ar->mixer_path[i].setting);
+    new_path_hash = malloc(size * sizeof(int));
+    if (new_path_hash == NULL) {
+        ALOGE("Unable to allocate path hash");
+        return -1;
     }
-    free(ar->mixer_path);
+
+    free(ar->path_hash);
+    ar->path_hash = new_path_hash;
+    ar->path_hash_size = size;
+    for (i = 0; i < size; i++)
+        ar->path_hash[i] = -1;
+
+    /* re-insert the existing paths */
+    for (i = 0; i < ar->num_mixer_paths; i++)
+        ar->path_hash[path_hash_slot(ar, ar->mixer_path[i].name)] = i;
+
+    return 0;
+}
+
+static int path_get_handle(struct audio_route *ar, const char *name)
+{
+    if (ar->path_hash_size == 0)
+        return -1;
+
+    return ar->path_hash[path_hash_slot(ar, name)];
 }
 
 static struct mixer_path *path_get_by_name(struct audio_route *ar,
                                            const char *name)
 {
-    unsigned int i;
+    int handle = path_get_handle(ar, name);
 
-    for (i = 0; i < ar->num_mixer_paths; i++)
-        if (strcmp(ar->mixer_path[i].name, name) == 0)
-            return &ar->mixer_path[i];
+    if (handle < 0)
+        return NULL;
 
-    return NULL;
+    return &ar->mixer_path[handle];
 }
 
 static struct mixer_path *path_create(struct audio_route *ar, const char *name)
@@ -104,6 +360,14 @@ static struct mixer_path *path_create(struct audio_route *ar, const char *name)
         return NULL;
     }
 
+    /* keep the hash at most half full so probe sequences stay short */
+    if (ar->path_hash_size <= (ar->num_mixer_paths + 1) * 2) {
+        if (path_hash_resize(ar, ar->path_hash_size ?
+                                 ar->path_hash_size * 2 :
+                                 INITIAL_PATH_HASH_SIZE) < 0)
+            return NULL;
+    }
+
     /* check if we need to allocate more space for mixer paths */
     if (ar->mixer_path_size <= ar->num_mixer_paths) {
         if (ar->mixer_path_size == 0)
@@ -122,10 +386,16 @@ static struct mixer_path *path_create(struct audio_route *ar, const char *name)
     }
 
     /* initialise the new mixer path */
-    ar->mixer_path[ar->num_mixer_paths].name = strdup(name);
+    ar->mixer_path[ar->num_mixer_paths].name =
+            arena_strdup(&ar->path_arena, name);
+    if (ar->mixer_path[ar->num_mixer_paths].name == NULL) {
+        ALOGE("Unable to allocate path name");
+        return NULL;
+    }
     ar->mixer_path[ar->num_mixer_paths].size = 0;
     ar->mixer_path[ar->num_mixer_paths].length = 0;
     ar->mixer_path[ar->num_mixer_paths].setting = NULL;
+    ar->path_hash[path_hash_slot(ar, name)] = ar->num_mixer_paths;
 
     /* return the mixer path just added, then increment number of them */
     return &ar->mixer_path[ar->num_mixer_paths++];
@@ -137,91 +407,163 @@ static bool path_setting_exists(struct mixer_path *path,
     unsigned int i;
 
     for (i = 0; i < path->length; i++)
-        if (path->setting[i].ctl == setting->ctl)
+        if (path->setting[i].ctl_index == setting->ctl_index)
             return true;
 
     return false;
 }
 
-static int path_add_setting(struct mixer_path *path,
+static int path_add_setting(struct audio_route *ar, struct mixer_path *path,
                             struct mixer_setting *setting)
 {
     struct mixer_setting *new_path_setting;
+    unsigned int new_size;
 
     if (path_setting_exists(path, setting)) {
         ALOGE("Duplicate path setting '%s'",
-              mixer_ctl_get_name(setting->ctl));
+              mixer_ctl_get_name(ar->mixer_state[setting->ctl_index].ctl));
         return -1;
     }
 
     /* check if we need to allocate more space for path settings */
     if (path->size <= path->length) {
         if (path->size == 0)
-            path->size = INITIAL_MIXER_PATH_SIZE;
+            new_size = INITIAL_MIXER_PATH_SIZE;
         else
-            path->size *= 2;
+            new_size = path->size * 2;
 
-        new_path_setting = realloc(path->setting,
-                                   path->size * sizeof(struct mixer_setting));
+        new_path_setting = arena_grow(&ar->path_arena, path->setting,
+                                      path->size * sizeof(struct mixer_setting),
+                                      new_size * sizeof(struct mixer_setting));
         if (new_path_setting == NULL) {
             ALOGE("Unable to allocate more path settings");
             return -1;
         } else {
             path->setting = new_path_setting;
+            path->size = new_size;
         }
     }
 
     /* initialise the new path setting */
-    path->setting[path->length].ctl = setting->ctl;
+    path->setting[path->length].ctl_index = setting->ctl_index;
     path->setting[path->length].value = setting->value;
     path->length++;
 
     return 0;
 }
 
-static int path_add_path(struct mixer_path *path, struct mixer_path *sub_path)
+static int path_add_path(struct audio_route *ar, struct mixer_path *path,
+                         struct mixer_path *sub_path)
 {
     unsigned int i;
 
     for (i = 0; i < sub_path->length; i++)
-        if (path_add_setting(path, &sub_path->setting[i]) < 0)
+        if (path_add_setting(ar, path, &sub_path->setting[i]) < 0)
             return -1;
 
     return 0;
 }
 
-static void path_print(struct mixer_path *path)
+static void path_print(struct audio_route *ar, struct mixer_path *path)
 {
     unsigned int i;
 
     ALOGV("Path: %s, length: %d", path->name, path->length);
     for (i = 0; i < path->length; i++)
-        ALOGV("  %d: %s -> %d", i, mixer_ctl_get_name(path->setting[i].ctl),
+        ALOGV("  %d: %s -> %d", i,
+              mixer_ctl_get_name(ar->mixer_state[path->setting[i].ctl_index].ctl),
               path->setting[i].value);
 }
 
-static int path_apply(struct audio_route *ar, struct mixer_path *path)
+/* collects the set of ctls touched by any path, so that reset_mixer_state()
+   only needs to visit those */
+static int path_collect_ctls(struct audio_route *ar)
 {
     unsigned int i;
     unsigned int j;
+    bool *used;
 
-    for (i = 0; i < path->length; i++) {
-        struct mixer_ctl *ctl = path->setting[i].ctl;
+    used = calloc(ar->num_mixer_ctls, sizeof(bool));
+    ar->path_ctl = malloc(ar->num_mixer_ctls * sizeof(unsigned int));
+    if (!used || !ar->path_ctl) {
+        ALOGE("Unable to allocate path ctl list");
+        free(used);
+        return -1;
+    }
 
-        /* locate the mixer ctl in the list */
-        for (j = 0; j < ar->num_mixer_ctls; j++) {
-            if (ar->mixer_state[j].ctl == ctl)
-                break;
+    ar->num_path_ctls = 0;
+    for (i = 0; i < ar->num_mixer_paths; i++) {
+        for (j = 0; j < ar->mixer_path[i].length; j++) {
+            unsigned int ctl_index = ar->mixer_path[i].setting[j].ctl_index;
+
+            if (!used[ctl_index]) {
+                used[ctl_index] = true;
+                ar->path_ctl[ar->num_path_ctls++] = ctl_index;
+            }
         }
+    }
+
+    free(used);
+    return 0;
+}
+
+static bool mixer_state_changed(struct mixer_state *ms)
+{
+    return memcmp(ms->old_value, ms->new_value,
+                  ms->num_values * sizeof(int)) != 0;
+}
+
+static void mixer_state_mark_dirty(struct audio_route *ar,
+                                   unsigned int ctl_index)
+{
+    struct mixer_state *ms = &ar->mixer_state[ctl_index];
+
+    if (!ms->dirty && mixer_state_changed(ms)) {
+        ms->dirty = true;
+        ar->dirty_ctl[ar->num_dirty_ctls++] = ctl_index;
+    }
+}
+
+/* sets all values of a ctl, to be committed by the next update_mixer_state() */
+static void mixer_state_set_value(struct audio_route *ar,
+                                  unsigned int ctl_index, int value)
+{
+    struct mixer_state *ms = &ar->mixer_state[ctl_index];
+    unsigned int i;
+
+    for (i = 0; i < ms->num_values; i++)
+        ms->new_value[i] = value;
+    mixer_state_mark_dirty(ar, ctl_index);
+}
+
+static int path_apply(struct audio_route *ar, struct mixer_path *path)
+{
+    unsigned int i;
+    unsigned int ctl_index;
+
+    for (i = 0; i < path->length; i++) {
+        ctl_index = path->setting[i].ctl_index;
 
         /* apply the new value */
-        ar->mixer_state[j].new_value = path->setting[i].value;
-ALOGE("path_apply: %s now %x\n", mixer_ctl_get_name(ctl), ar->mixer_state[j].new_value);
+        mixer_state_set_value(ar, ctl_index, path->setting[i].value);
     }
 
     return 0;
 }
 
+/* returns the index of the named ctl in mixer_state, or -1 if not found */
+static int mixer_state_find_ctl(struct audio_route *ar, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < ar->num_mixer_ctls; i++) {
+        if (strcmp(mixer_ctl_get_name(ar->mixer_state[i].ctl), name) == 0)
+            return i;
+    }
+
+    return -1;
+}
+
 /* mixer helper function */
 static int mixer_enum_string_to_value(struct mixer_ctl *ctl, const char *string)
 {
@@ -245,6 +587,7 @@ static void start_tag(void *data, const XML_Char *tag_name,
     struct audio_route *ar = state->ar;
     unsigned int i;
     struct mixer_ctl *ctl;
+    int ctl_index;
     int value;
     struct mixer_setting mixer_setting;
 
@@ -267,14 +610,24 @@ static void start_tag(void *data, const XML_Char *tag_name,
             } else {
                 /* nested path */
                 struct mixer_path *sub_path = path_get_by_name(ar, attr_name);
-                path_add_path(state->path, sub_path);
+                if (!sub_path)
+                    ALOGE("Unknown path '%s' in path", attr_name);
+                else if (!state->path)
+                    ALOGE("Path '%s' not within a valid path", attr_name);
+                else
+                    path_add_path(ar, state->path, sub_path);
             }
         }
     }
 
     else if (strcmp(tag_name, "ctl") == 0) {
         /* Obtain the mixer ctl and value */
-        ctl = mixer_get_ctl_by_name(ar->mixer, attr_name);
+        ctl_index = mixer_state_find_ctl(ar, attr_name);
+        if (ctl_index < 0) {
+            ALOGE("Unknown mixer ctl '%s'", attr_name);
+            goto done;
+        }
+        ctl = ar->mixer_state[ctl_index].ctl;
         switch (mixer_ctl_get_type(ctl)) {
         case MIXER_CTL_TYPE_BOOL:
         case MIXER_CTL_TYPE_INT:
@@ -291,22 +644,22 @@ static void start_tag(void *data, const XML_Char *tag_name,
         if (state->level == 1) {
             /* top level ctl (initial setting) */
 
-            /* locate the mixer ctl in the list */
-            for (i = 0; i < ar->num_mixer_ctls; i++) {
-                if (ar->mixer_state[i].ctl == ctl)
-                    break;
-            }
-
-            /* apply the new value */
-            ar->mixer_state[i].new_value = value;
+            /* apply the new value, and keep it for the route cache */
+            mixer_state_set_value(ar, ctl_index, value);
+            mixer_setting.ctl_index = ctl_index;
+            mixer_setting.value = value;
+            path_add_setting(ar, &ar->initial_path, &mixer_setting);
+        } else if (!state->path) {
+            ALOGE("Mixer ctl '%s' not within a valid path", attr_name);
         } else {
             /* nested ctl (within a path) */
-            mixer_setting.ctl = ctl;
+            mixer_setting.ctl_index = ctl_index;
             mixer_setting.value = value;
-            path_add_setting(state->path, &mixer_setting);
+            path_add_setting(ar, state->path, &mixer_setting);
         }
     }
 
+done:
     state->level++;
 }
 
@@ -315,58 +668,169 @@ static void end_tag(void *data, const XML_Char *tag_name)
     struct config_parse_state *state = data;
 
     state->level--;
+
+    /* a ctl or path found after this one is not part of it */
+    if (state->level == 1 && strcmp(tag_name, "path") == 0)
+        state->path = NULL;
+}
+
+#ifdef MIXER_CTL_ARRAY
+/* bool and int ctls can be read and written in a single ioctl as an array */
+static bool mixer_state_is_array(struct mixer_state *ms)
+{
+    return (ms->type == MIXER_CTL_TYPE_BOOL) ||
+           (ms->type == MIXER_CTL_TYPE_INT);
+}
+#endif
+
+/* reads all values of a ctl from the mixer */
+static void mixer_state_read(struct mixer_state *ms)
+{
+    unsigned int i;
+
+#ifdef MIXER_CTL_ARRAY
+    long values[MAX_CTL_VALUES];
+
+    if (mixer_state_is_array(ms) &&
+            (mixer_ctl_get_array(ms->ctl, values, ms->num_values) == 0)) {
+        for (i = 0; i < ms->num_values; i++)
+            ms->old_value[i] = values[i];
+        return;
+    }
+#endif
+
+    for (i = 0; i < ms->num_values; i++)
+        ms->old_value[i] = mixer_ctl_get_value(ms->ctl, i);
+}
+
+/* writes the new values of a ctl to the mixer */
+static void mixer_state_write(struct mixer_state *ms)
+{
+    unsigned int i;
+
+#ifdef MIXER_CTL_ARRAY
+    long values[MAX_CTL_VALUES];
+
+    if (mixer_state_is_array(ms)) {
+        for (i = 0; i < ms->num_values; i++)
+            values[i] = ms->new_value[i];
+        if (mixer_ctl_set_array(ms->ctl, values, ms->num_values) == 0)
+            return;
+    }
+#endif
+
+    /* one write per changed value */
+    for (i = 0; i < ms->num_values; i++) {
+        if (ms->old_value[i] != ms->new_value[i])
+            mixer_ctl_set_value(ms->ctl, i, ms->new_value[i]);
+    }
 }
 
 static int alloc_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
+    unsigned int num_values = 0;
+    int *values;
 
     ar->num_mixer_ctls = mixer_get_num_ctls(ar->mixer);
     ar->mixer_state = malloc(ar->num_mixer_ctls * sizeof(struct mixer_state));
     if (!ar->mixer_state)
         return -1;
 
+    ar->num_dirty_ctls = 0;
+    ar->dirty_ctl = malloc(ar->num_mixer_ctls * sizeof(unsigned int));
+    if (!ar->dirty_ctl)
+        goto err_dirty_ctl;
+
     for (i = 0; i < ar->num_mixer_ctls; i++) {
         ar->mixer_state[i].ctl = mixer_get_ctl(ar->mixer, i);
-        /* only get value 0, assume multiple ctl values are the same */
-        ar->mixer_state[i].old_value = mixer_ctl_get_value(ar->mixer_state[i].ctl, 0);
-        ar->mixer_state[i].new_value = ar->mixer_state[i].old_value;
+        ar->mixer_state[i].type = mixer_ctl_get_type(ar->mixer_state[i].ctl);
+        ar->mixer_state[i].num_values =
+                mixer_ctl_get_num_values(ar->mixer_state[i].ctl);
+        if (ar->mixer_state[i].num_values > MAX_CTL_VALUES) {
+            ALOGW("ctl %s has %u values, only the first %u are routed",
+                  mixer_ctl_get_name(ar->mixer_state[i].ctl),
+                  ar->mixer_state[i].num_values, MAX_CTL_VALUES);
+            ar->mixer_state[i].num_values = MAX_CTL_VALUES;
+        }
+        num_values += ar->mixer_state[i].num_values;
+    }
+
+    /* old, new and reset values for every ctl share one allocation */
+    ar->mixer_values = malloc(num_values * 3 * sizeof(int));
+    if (!ar->mixer_values)
+        goto err_mixer_values;
+
+    values = ar->mixer_values;
+    for (i = 0; i < ar->num_mixer_ctls; i++) {
+        struct mixer_state *ms = &ar->mixer_state[i];
+
+        ms->old_value = values;
+        ms->new_value = values + ms->num_values;
+        ms->reset_value = values + ms->num_values * 2;
+        values += ms->num_values * 3;
+
+        mixer_state_read(ms);
+        memcpy(ms->new_value, ms->old_value, ms->num_values * sizeof(int));
+        ms->dirty = false;
     }
 
     return 0;
+
+err_mixer_values:
+    free(ar->dirty_ctl);
+    ar->dirty_ctl = NULL;
+err_dirty_ctl:
+    free(ar->mixer_state);
+    ar->mixer_state = NULL;
+    return -1;
 }
 
 static void free_mixer_state(struct audio_route *ar)
 {
     free(ar->mixer_state);
     ar->mixer_state = NULL;
+    free(ar->mixer_values);
+    ar->mixer_values = NULL;
+    free(ar->dirty_ctl);
+    ar->dirty_ctl = NULL;
 }
 
 void update_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
-    unsigned int j;
+    unsigned int written = 0;
+    struct mixer_state *ms;
+
+    AUDIO_TRACE(AUDIO_TRACE_MIXER_COMMIT_BEGIN, ar->num_dirty_ctls);
+
+    /* only the ctls on the dirty list can have changed */
+    for (i = 0; i < ar->num_dirty_ctls; i++) {
+        ms = &ar->mixer_state[ar->dirty_ctl[i]];
+        ms->dirty = false;
 
-    for (i = 0; i < ar->num_mixer_ctls; i++) {
         /* if the value has changed, update the mixer */
-        if (ar->mixer_state[i].old_value != ar->mixer_state[i].new_value) {
-            /* set all ctl values the same */
-            for (j = 0; j < mixer_ctl_get_num_values(ar->mixer_state[i].ctl); j++)
-                mixer_ctl_set_value(ar->mixer_state[i].ctl, j,
-                                    ar->mixer_state[i].new_value);
-            ar->mixer_state[i].old_value = ar->mixer_state[i].new_value;
+        if (mixer_state_changed(ms)) {
+            AUDIO_TRACE(AUDIO_TRACE_MIXER_CTL, ar->dirty_ctl[i]);
+            mixer_state_write(ms);
+            memcpy(ms->old_value, ms->new_value, ms->num_values * sizeof(int));
+            written++;
         }
     }
+    ar->num_dirty_ctls = 0;
+
+    AUDIO_TRACE(AUDIO_TRACE_MIXER_COMMIT_END, written);
 }
 
-/* saves the current state of the mixer, for resetting all controls */
+/* saves the committed state of the mixer, for resetting all controls */
 static void save_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
+    struct mixer_state *ms;
 
     for (i = 0; i < ar->num_mixer_ctls; i++) {
-        /* only get value 0, assume multiple ctl values are the same */
-        ar->mixer_state[i].reset_value = mixer_ctl_get_value(ar->mixer_state[i].ctl, 0);
+        ms = &ar->mixer_state[i];
+        memcpy(ms->reset_value, ms->old_value, ms->num_values * sizeof(int));
     }
 }
 
@@ -374,17 +838,197 @@ static void save_mixer_state(struct audio_route *ar)
 void reset_mixer_state(struct audio_route *ar)
 {
     unsigned int i;
+    unsigned int ctl_index;
+    struct mixer_state *ms;
+
+    /* load the saved values, only path ctls can differ from them */
+    for (i = 0; i < ar->num_path_ctls; i++) {
+        ctl_index = ar->path_ctl[i];
+        ms = &ar->mixer_state[ctl_index];
+        memcpy(ms->new_value, ms->reset_value, ms->num_values * sizeof(int));
+        mixer_state_mark_dirty(ar, ctl_index);
+    }
+}
+
+int audio_route_get_path_handle(struct audio_route *ar, const char *name)
+{
+    int handle;
+
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
+    }
+
+    handle = path_get_handle(ar, name);
+    if (handle < 0)
+        ALOGE("unable to find path '%s'", name);
+
+    return handle;
+}
+
+void audio_route_apply_path_handle(struct audio_route *ar, int handle)
+{
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return;
+    }
+
+    if ((handle < 0) || ((unsigned int)handle >= ar->num_mixer_paths)) {
+        ALOGE("invalid path handle %d", handle);
+        return;
+    }
+
+    AUDIO_TRACE(AUDIO_TRACE_PATH_APPLY, handle);
+    path_apply(ar, &ar->mixer_path[handle]);
+}
+
+/* route combination functions */
+
+static void route_combo_free(struct audio_route *ar)
+{
+    unsigned int i;
+
+    for (i = 0; i < ROUTE_COMBO_CACHE_SIZE; i++) {
+        free(ar->route_combo[i].setting);
+        ar->route_combo[i].setting = NULL;
+        ar->route_combo[i].valid = false;
+    }
+}
+
+static bool route_combo_matches(struct route_combo *combo, const int *handles,
+                                unsigned int num_handles)
+{
+    return combo->valid && (combo->num_handles == num_handles) &&
+           (memcmp(combo->handle, handles, num_handles * sizeof(int)) == 0);
+}
+
+/* composes the paths into a single list of settings, later paths taking
+   precedence where they share a ctl */
+static int route_combo_compose(struct audio_route *ar,
+                               struct route_combo *combo, const int *handles,
+                               unsigned int num_handles)
+{
+    struct mixer_path *path;
+    unsigned int *slot;
+    unsigned int max_length = 0;
+    unsigned int ctl_index;
+    unsigned int i;
+    unsigned int j;
 
-    /* load all of the saved values */
-    for (i = 0; i < ar->num_mixer_ctls; i++)
-        ar->mixer_state[i].new_value = ar->mixer_state[i].reset_value;
+    for (i = 0; i < num_handles; i++)
+        if ((handles[i] >= 0) && ((unsigned int)handles[i] < ar->num_mixer_paths))
+            max_length += ar->mixer_path[handles[i]].length;
+
+    /* slot[ctl] is the position of the ctl in the composed list, plus one */
+    slot = calloc(ar->num_mixer_ctls, sizeof(unsigned int));
+    combo->setting = malloc((max_length ? max_length : 1) *
+                            sizeof(struct mixer_setting));
+    if (!slot || !combo->setting) {
+        ALOGE("Unable to allocate route combination");
+        free(slot);
+        free(combo->setting);
+        combo->setting = NULL;
+        return -1;
+    }
+
+    combo->length = 0;
+    for (i = 0; i < num_handles; i++) {
+        if ((handles[i] < 0) || ((unsigned int)handles[i] >= ar->num_mixer_paths)) {
+            ALOGE("invalid path handle %d", handles[i]);
+            continue;
+        }
+
+        path = &ar->mixer_path[handles[i]];
+        for (j = 0; j < path->length; j++) {
+            ctl_index = path->setting[j].ctl_index;
+            if (slot[ctl_index] == 0) {
+                combo->setting[combo->length].ctl_index = ctl_index;
+                slot[ctl_index] = ++combo->length;
+            }
+            combo->setting[slot[ctl_index] - 1].value = path->setting[j].value;
+        }
+    }
+
+    free(slot);
+
+    memcpy(combo->handle, handles, num_handles * sizeof(int));
+    combo->num_handles = num_handles;
+    combo->valid = true;
+
+    return 0;
+}
+
+/* returns the cached composition of the paths, composing it into the least
+   recently used slot if needed */
+static struct route_combo *route_combo_get(struct audio_route *ar,
+                                           const int *handles,
+                                           unsigned int num_handles)
+{
+    struct route_combo *combo = NULL;
+    unsigned int i;
+
+    if (num_handles > MAX_COMBO_PATHS)
+        return NULL;
+
+    for (i = 0; i < ROUTE_COMBO_CACHE_SIZE; i++) {
+        if (route_combo_matches(&ar->route_combo[i], handles, num_handles)) {
+            combo = &ar->route_combo[i];
+            break;
+        }
+        if (!combo || !ar->route_combo[i].valid ||
+                (combo->valid &&
+                 (ar->route_combo[i].last_used < combo->last_used)))
+            combo = &ar->route_combo[i];
+    }
+
+    if (!route_combo_matches(combo, handles, num_handles)) {
+        free(combo->setting);
+        combo->setting = NULL;
+        combo->valid = false;
+        if (route_combo_compose(ar, combo, handles, num_handles) < 0)
+            return NULL;
+    }
+
+    combo->last_used = ++ar->route_combo_clock;
+
+    return combo;
+}
+
+int audio_route_apply_paths(struct audio_route *ar, const int *handles,
+                            unsigned int num_handles)
+{
+    struct route_combo *combo;
+    unsigned int i;
+
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
+    }
+
+    /* build the complete target state before committing anything, so the
+       commit only touches ctls whose final value differs */
+    reset_mixer_state(ar);
+
+    combo = route_combo_get(ar, handles, num_handles);
+    if (combo) {
+        for (i = 0; i < combo->length; i++)
+            mixer_state_set_value(ar, combo->setting[i].ctl_index,
+                                  combo->setting[i].value);
+    } else {
+        /* too many paths to cache, or out of memory: apply them directly */
+        for (i = 0; i < num_handles; i++)
+            audio_route_apply_path_handle(ar, handles[i]);
+    }
+
+    update_mixer_state(ar);
+
+    return 0;
 }
 
 void audio_route_apply_path(struct audio_route *ar, const char *name)
 {
     struct mixer_path *path;
 
-ALOGE("audio_route_apply_path %s\n", name);
     if (!ar) {
         ALOGE("invalid audio_route");
         return;
@@ -396,19 +1040,376 @@ ALOGE("audio_route_apply_path %s\n", name);
         return;
     }
 
+    AUDIO_TRACE(AUDIO_TRACE_PATH_APPLY, path - ar->mixer_path);
     path_apply(ar, path);
 }
 
-struct audio_route *audio_route_init(void)
+/* route cache functions */
+
+static uint32_t mixer_ctl_signature(struct audio_route *ar)
+{
+    unsigned int hash = HASH_INIT;
+    unsigned int i;
+    struct mixer_state *ms;
+    const char *name;
+
+    for (i = 0; i < ar->num_mixer_ctls; i++) {
+        ms = &ar->mixer_state[i];
+        name = mixer_ctl_get_name(ms->ctl);
+        hash = hash_bytes(hash, name, strlen(name) + 1);
+        hash = hash_bytes(hash, &ms->type, sizeof(ms->type));
+        hash = hash_bytes(hash, &ms->num_values, sizeof(ms->num_values));
+    }
+
+    return hash;
+}
+
+/* maps the whole mixer XML file read-only */
+static void *mixer_xml_map(struct stat *xml_stat)
+{
+    void *xml;
+    int fd;
+
+    fd = open(MIXER_XML_PATH, O_RDONLY);
+    if (fd < 0) {
+        ALOGE("Failed to open %s", MIXER_XML_PATH);
+        return NULL;
+    }
+
+    if ((fstat(fd, xml_stat) < 0) || (xml_stat->st_size == 0)) {
+        ALOGE("Failed to stat %s", MIXER_XML_PATH);
+        close(fd);
+        return NULL;
+    }
+
+    xml = mmap(NULL, xml_stat->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (xml == MAP_FAILED) {
+        ALOGE("Failed to map %s", MIXER_XML_PATH);
+        return NULL;
+    }
+
+    return xml;
+}
+
+static void route_cache_get_key(struct audio_route *ar, const void *xml,
+                                const struct stat *xml_stat,
+                                struct route_cache_key *key)
+{
+    memset(key, 0, sizeof(*key));
+    key->xml_mtime = xml_stat->st_mtime;
+    key->xml_size = xml_stat->st_size;
+    key->xml_hash = hash_bytes(HASH_INIT, xml, xml_stat->st_size);
+    key->ctl_signature = mixer_ctl_signature(ar);
+}
+
+/* checks that a mapped route cache was compiled for the live mixer, and that
+   every offset, ctl index and value in it is in range, before any of it is
+   used */
+static bool route_cache_check(struct audio_route *ar, const void *map,
+                              size_t size, const struct route_cache_key *key)
+{
+    const struct route_cache_header *header = map;
+    const struct route_cache_path *cache_path;
+    const struct mixer_setting *setting;
+    const struct mixer_state *ms;
+    const char *names;
+    uint64_t expected_size;
+    unsigned int i;
+
+    if ((size < sizeof(*header)) ||
+            (header->magic != ROUTE_CACHE_MAGIC) ||
+            (header->version != ROUTE_CACHE_VERSION) ||
+            (memcmp(&header->key, key, sizeof(*key)) != 0) ||
+            (header->num_ctls != ar->num_mixer_ctls))
+        return false;
+
+    /* 64 bit, so that no count in the header can wrap the sum around */
+    expected_size = sizeof(*header) +
+            ((uint64_t)header->num_paths + 1) * sizeof(*cache_path) +
+            (uint64_t)header->num_settings * sizeof(*setting) +
+            header->names_size;
+    if (expected_size != size)
+        return false;
+
+    cache_path = (const struct route_cache_path *)(header + 1);
+    setting = (const struct mixer_setting *)(cache_path + header->num_paths + 1);
+    names = (const char *)(setting + header->num_settings);
+
+    /* the values are those the XML parser produces for the ctl type */
+    for (i = 0; i < header->num_settings; i++) {
+        if (setting[i].ctl_index >= ar->num_mixer_ctls)
+            return false;
+        ms = &ar->mixer_state[setting[i].ctl_index];
+        switch (ms->type) {
+        case MIXER_CTL_TYPE_BOOL:
+        case MIXER_CTL_TYPE_INT:
+            break;
+        case MIXER_CTL_TYPE_ENUM:
+            if ((setting[i].value < 0) ||
+                    ((unsigned int)setting[i].value >
+                        mixer_ctl_get_num_enums(ms->ctl)))
+                return false;
+            break;
+        default:
+            if (setting[i].value != 0)
+                return false;
+            break;
+        }
+    }
+
+    for (i = 0; i <= header->num_paths; i++) {
+        if ((cache_path[i].first_setting > header->num_settings) ||
+                (cache_path[i].num_settings >
+                    header->num_settings - cache_path[i].first_setting) ||
+                ((i > 0) && (cache_path[i].name_offset >= header->names_size)))
+            return false;
+    }
+    if ((header->names_size > 0) && (names[header->names_size - 1] != '\0'))
+        return false;
+
+    return true;
+}
+
+/* loads the paths from a compiled route cache, if it matches the key */
+static int route_cache_load(struct audio_route *ar, const char *path,
+                            const struct route_cache_key *key)
+{
+    const struct route_cache_header *header;
+    const struct route_cache_path *cache_path;
+    struct mixer_setting *setting;
+    const char *names;
+    struct stat cache_stat;
+    unsigned int hash_size;
+    unsigned int i;
+    void *map;
+    size_t size;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return -1;
+
+    if ((fstat(fd, &cache_stat) < 0) ||
+            ((size_t)cache_stat.st_size < sizeof(*header))) {
+        close(fd);
+        return -1;
+    }
+
+    size = cache_stat.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    if (!route_cache_check(ar, map, size, key)) {
+        ALOGV("Route cache %s is stale or corrupt", path);
+        goto err;
+    }
+
+    header = map;
+    cache_path = (const struct route_cache_path *)(header + 1);
+    setting = (struct mixer_setting *)(cache_path + header->num_paths + 1);
+    names = (const char *)(setting + header->num_settings);
+
+    if (header->num_paths > 0) {
+        ar->mixer_path = malloc(header->num_paths * sizeof(struct mixer_path));
+        if (!ar->mixer_path)
+            goto err;
+    }
+
+    /* the first entry holds the initial settings */
+    ar->initial_path.name = NULL;
+    ar->initial_path.size = cache_path[0].num_settings;
+    ar->initial_path.length = cache_path[0].num_settings;
+    ar->initial_path.setting = setting + cache_path[0].first_setting;
+
+    for (i = 0; i < header->num_paths; i++) {
+        ar->mixer_path[i].name = (char *)names + cache_path[i + 1].name_offset;
+        ar->mixer_path[i].size = cache_path[i + 1].num_settings;
+        ar->mixer_path[i].length = cache_path[i + 1].num_settings;
+        ar->mixer_path[i].setting = setting + cache_path[i + 1].first_setting;
+    }
+    ar->num_mixer_paths = header->num_paths;
+    ar->mixer_path_size = header->num_paths;
+
+    hash_size = INITIAL_PATH_HASH_SIZE;
+    while (hash_size <= (ar->num_mixer_paths + 1) * 2)
+        hash_size *= 2;
+    if (path_hash_resize(ar, hash_size) < 0) {
+        free(ar->mixer_path);
+        ar->mixer_path = NULL;
+        ar->num_mixer_paths = 0;
+        ar->mixer_path_size = 0;
+        memset(&ar->initial_path, 0, sizeof(ar->initial_path));
+        goto err;
+    }
+
+    ar->route_cache = map;
+    ar->route_cache_size = size;
+
+    path_apply(ar, &ar->initial_path);
+
+    return 0;
+
+err:
+    munmap(map, size);
+    return -1;
+}
+
+static int route_cache_save(struct audio_route *ar, const char *path,
+                            const struct route_cache_key *key)
+{
+    struct route_cache_header header;
+    struct route_cache_path cache_path;
+    char tmp_path[PATH_MAX];
+    struct mixer_path *mixer_path;
+    FILE *file;
+    unsigned int i;
+    int ret = 0;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = ROUTE_CACHE_MAGIC;
+    header.version = ROUTE_CACHE_VERSION;
+    header.key = *key;
+    header.num_ctls = ar->num_mixer_ctls;
+    header.num_paths = ar->num_mixer_paths;
+    header.num_settings = ar->initial_path.length;
+    for (i = 0; i < ar->num_mixer_paths; i++) {
+        header.num_settings += ar->mixer_path[i].length;
+        header.names_size += strlen(ar->mixer_path[i].name) + 1;
+    }
+
+    /* write to a temporary file and rename it, so readers never see a
+       partially written cache */
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    file = fopen(tmp_path, "wb");
+    if (!file) {
+        ALOGV("Unable to create route cache %s", tmp_path);
+        return -1;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        ret = -1;
+
+    cache_path.name_offset = 0;
+    cache_path.first_setting = 0;
+    for (i = 0; i <= ar->num_mixer_paths; i++) {
+        mixer_path = (i == 0) ? &ar->initial_path : &ar->mixer_path[i - 1];
+        cache_path.num_settings = mixer_path->length;
+        if (fwrite(&cache_path, sizeof(cache_path), 1, file) != 1)
+            ret = -1;
+        cache_path.first_setting += mixer_path->length;
+        if (i > 0)
+            cache_path.name_offset += strlen(mixer_path->name) + 1;
+    }
+
+    for (i = 0; i <= ar->num_mixer_paths; i++) {
+        mixer_path = (i == 0) ? &ar->initial_path : &ar->mixer_path[i - 1];
+        if ((mixer_path->length > 0) &&
+                (fwrite(mixer_path->setting, sizeof(struct mixer_setting),
+                        mixer_path->length, file) != mixer_path->length))
+            ret = -1;
+    }
+
+    for (i = 0; i < ar->num_mixer_paths; i++) {
+        if (fwrite(ar->mixer_path[i].name,
+                   strlen(ar->mixer_path[i].name) + 1, 1, file) != 1)
+            ret = -1;
+    }
+
+    /* the cache must be on disk before the rename makes it visible */
+    if ((fflush(file) != 0) || (fsync(fileno(file)) < 0))
+        ret = -1;
+
+    if (fclose(file) != 0)
+        ret = -1;
+
+    if ((ret == 0) && (rename(tmp_path, path) < 0))
+        ret = -1;
+
+    if (ret < 0) {
+        ALOGE("Unable to write route cache %s", path);
+        unlink(tmp_path);
+    }
+
+    return ret;
+}
+
+int audio_route_write_cache(struct audio_route *ar, const char *path)
+{
+    struct route_cache_key key;
+    struct stat xml_stat;
+    void *xml;
+
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
+    }
+
+    xml = mixer_xml_map(&xml_stat);
+    if (!xml)
+        return -1;
+    route_cache_get_key(ar, xml, &xml_stat, &key);
+    munmap(xml, xml_stat.st_size);
+
+    return route_cache_save(ar, path, &key);
+}
+
+int audio_route_save_cache(struct audio_route *ar)
+{
+    if (!ar) {
+        ALOGE("invalid audio_route");
+        return -1;
+    }
+
+    if (ar->route_cache_attempts == 0)
+        return 0;
+
+    /* without a cache the XML is simply parsed again at the next init */
+    if (route_cache_save(ar, MIXER_CACHE_PATH, &ar->route_cache_key) < 0) {
+        ar->route_cache_attempts--;
+        return -1;
+    }
+
+    ar->route_cache_attempts = 0;
+    return 0;
+}
+
+static int mixer_xml_load(struct audio_route *ar, const void *xml,
+                          size_t size)
 {
     struct config_parse_state state;
     XML_Parser parser;
-    FILE *file;
-    int bytes_read;
-    void *buf;
-    int i;
-    struct mixer_path *path;
+    int ret = 0;
+
+    parser = XML_ParserCreate(NULL);
+    if (!parser) {
+        ALOGE("Failed to create XML parser");
+        return -1;
+    }
+
+    memset(&state, 0, sizeof(state));
+    state.ar = ar;
+    XML_SetUserData(parser, &state);
+    XML_SetElementHandler(parser, start_tag, end_tag);
+
+    /* the file is mapped, so parse it in one go */
+    if (XML_Parse(parser, xml, size, 1) == XML_STATUS_ERROR) {
+        ALOGE("Error in mixer xml (%s)", MIXER_XML_PATH);
+        ret = -1;
+    }
+
+    XML_ParserFree(parser);
+    return ret;
+}
+
+struct audio_route *audio_route_init(void)
+{
+    struct route_cache_key key;
+    struct stat xml_stat;
     struct audio_route *ar;
+    void *xml;
 
     ar = calloc(1, sizeof(struct audio_route));
     if (!ar)
@@ -423,61 +1424,47 @@ struct audio_route *audio_route_init(void)
     ar->mixer_path = NULL;
     ar->mixer_path_size = 0;
     ar->num_mixer_paths = 0;
+    ar->path_hash = NULL;
+    ar->path_hash_size = 0;
+    ar->path_ctl = NULL;
+    ar->num_path_ctls = 0;
+    ar->route_cache = NULL;
 
     /* allocate space for and read current mixer settings */
     if (alloc_mixer_state(ar) < 0)
         goto err_mixer_state;
 
-    file = fopen(MIXER_XML_PATH, "r");
-    if (!file) {
-        ALOGE("Failed to open %s", MIXER_XML_PATH);
-        goto err_fopen;
+    xml = mixer_xml_map(&xml_stat);
+    if (!xml)
+        goto err_xml_map;
+
+    /* use the compiled route cache if it matches the XML and the mixer,
+       otherwise parse the XML. The cache is refreshed later, by
+       audio_route_save_cache(), as /data may not be writable yet */
+    route_cache_get_key(ar, xml, &xml_stat, &key);
+    if (route_cache_load(ar, MIXER_CACHE_PATH, &key) < 0) {
+        if (mixer_xml_load(ar, xml, xml_stat.st_size) < 0)
+            goto err_load;
+        ar->route_cache_key = key;
+        ar->route_cache_attempts = ROUTE_CACHE_SAVE_ATTEMPTS;
     }
 
-    parser = XML_ParserCreate(NULL);
-    if (!parser) {
-        ALOGE("Failed to create XML parser");
-        goto err_parser_create;
-    }
-
-    memset(&state, 0, sizeof(state));
-    state.ar = ar;
-    XML_SetUserData(parser, &state);
-    XML_SetElementHandler(parser, start_tag, end_tag);
-
-    for (;;) {
-        buf = XML_GetBuffer(parser, BUF_SIZE);
-        if (buf == NULL)
-            goto err_parse;
+    if (path_collect_ctls(ar) < 0)
+        goto err_load;
 
-        bytes_read = fread(buf, 1, BUF_SIZE, file);
-        if (bytes_read < 0)
-            goto err_parse;
-
-        if (XML_ParseBuffer(parser, bytes_read,
-                            bytes_read == 0) == XML_STATUS_ERROR) {
-            ALOGE("Error in mixer xml (%s)", MIXER_XML_PATH);
-            goto err_parse;
-        }
-
-        if (bytes_read == 0)
-            break;
-    }
+    munmap(xml, xml_stat.st_size);
 
     /* apply the initial mixer values, and save them so we can reset the
        mixer to the original values */
     update_mixer_state(ar);
     save_mixer_state(ar);
 
-    XML_ParserFree(parser);
-    fclose(file);
     return ar;
 
-err_parse:
-    XML_ParserFree(parser);
-err_parser_create:
-    fclose(file);
-err_fopen:
+err_load:
+    munmap(xml, xml_stat.st_size);
+    path_free(ar);
+err_xml_map:
     free_mixer_state(ar);
 err_mixer_state:
     mixer_close(ar->mixer);
@@ -490,6 +1477,11 @@ err_calloc:
 
 void audio_route_free(struct audio_route *ar)
 {
+    if (!ar)
+        return;
+
+    route_combo_free(ar);
+    path_free(ar);
     free_mixer_state(ar);
     mixer_close(ar->mixer);
     free(ar);
@@ -24,6 +24,29 @@ void audio_route_free(struct audio_route *ar);
 /* Applies an audio route path by name */
 void audio_route_apply_path(struct audio_route *ar, const char *name);
 
+/* Looks up a path by name once, returning a handle that stays valid until
+   audio_route_free(), or -1 if there is no such path */
+int audio_route_get_path_handle(struct audio_route *ar, const char *name);
+
+/* Applies an audio route path by handle */
+void audio_route_apply_path_handle(struct audio_route *ar, int handle);
+
+/* Routes the mixer to exactly the given set of paths in one transaction:
+   everything else goes back to its initial state, and only ctls whose final
+   value changes are written. Recently used sets are cached. */
+int audio_route_apply_paths(struct audio_route *ar, const int *handles,
+                            unsigned int num_handles);
+
+/* Writes the paths to a compiled route cache file, which audio_route_init()
+   uses instead of parsing the XML while the XML and mixer are unchanged */
+int audio_route_write_cache(struct audio_route *ar, const char *path);
+
+/* Writes the route cache audio_route_init() would have used, if it had to
+   parse the XML instead. Called off the init path, once storage may be
+   writable; after a few failed tries the XML keeps being parsed at init.
+   Returns 0 if the cache is up to date */
+int audio_route_save_cache(struct audio_route *ar);
+
 /* Resets the mixer back to its initial state */
 void reset_mixer_state(struct audio_route *ar);
 
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times audio_route_init() and route switches against the mixer of this
+ * device, e.g. "audio_route_bench speaker headphone mic". Each switch
+ * routes the mixer to one of the given paths, going round them in turn,
+ * so every iteration writes real ctls. The mixer is reset on exit.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_route.h"
+
+#define DEFAULT_ITERATIONS 100
+
+struct timing {
+    int64_t min_ns;
+    int64_t max_ns;
+    int64_t total_ns;
+    unsigned int count;
+};
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void timing_add(struct timing *timing, int64_t ns)
+{
+    if (timing->count == 0 || ns < timing->min_ns)
+        timing->min_ns = ns;
+    if (ns > timing->max_ns)
+        timing->max_ns = ns;
+    timing->total_ns += ns;
+    timing->count++;
+}
+
+static void timing_print(const char *name, const struct timing *timing)
+{
+    if (timing->count == 0)
+        return;
+
+    printf("%-16s %8.3f %8.3f %8.3f ms over %u runs\n", name,
+           timing->min_ns / 1000000.0,
+           timing->total_ns / 1000000.0 / timing->count,
+           timing->max_ns / 1000000.0, timing->count);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_route *ar;
+    struct timing init_timing;
+    struct timing switch_timing;
+    unsigned int iterations = DEFAULT_ITERATIONS;
+    int *handles;
+    int num_handles = 0;
+    unsigned int i;
+    int arg = 1;
+    int64_t start;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        iterations = strtoul(argv[2], NULL, 0);
+        arg = 3;
+    }
+    if (iterations == 0) {
+        fprintf(stderr, "Usage: %s [-n iterations] [path...]\n", argv[0]);
+        return 1;
+    }
+
+    memset(&init_timing, 0, sizeof(init_timing));
+    memset(&switch_timing, 0, sizeof(switch_timing));
+
+    /* the route cache, if present, is used as by the HAL */
+    for (i = 0; i < iterations; i++) {
+        start = now_ns();
+        ar = audio_route_init();
+        timing_add(&init_timing, now_ns() - start);
+        if (!ar) {
+            fprintf(stderr, "Unable to load the audio routes\n");
+            return 1;
+        }
+        if (i + 1 < iterations)
+            audio_route_free(ar);
+    }
+
+    handles = calloc(argc, sizeof(int));
+    if (!handles) {
+        audio_route_free(ar);
+        return 1;
+    }
+    for (; arg < argc; arg++) {
+        int handle = audio_route_get_path_handle(ar, argv[arg]);
+
+        if (handle < 0)
+            fprintf(stderr, "Ignoring unknown path '%s'\n", argv[arg]);
+        else
+            handles[num_handles++] = handle;
+    }
+
+    for (i = 0; num_handles > 0 && i < iterations; i++) {
+        start = now_ns();
+        audio_route_apply_paths(ar, &handles[i % num_handles], 1);
+        timing_add(&switch_timing, now_ns() - start);
+    }
+    audio_route_apply_paths(ar, handles, 0);
+
+    printf("%-16s %8s %8s %8s\n", "", "min", "avg", "max");
+    timing_print("init", &init_timing);
+    timing_print("route switch", &switch_timing);
+
+    free(handles);
+    audio_route_free(ar);
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compiles /system/etc/mixer_paths.xml into a route cache for the mixer
+ * of this device. The cache stores mixer ctl indices, so it has to be
+ * generated against the same mixer the HAL will open.
+ */
+
+#include <stdio.h>
+
+#include "audio_route.h"
+
+int main(int argc, char **argv)
+{
+    struct audio_route *ar;
+    int ret;
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <cache file>\n", argv[0]);
+        return 1;
+    }
+
+    ar = audio_route_init();
+    if (!ar) {
+        fprintf(stderr, "Unable to load the audio routes\n");
+        return 1;
+    }
+
+    ret = audio_route_write_cache(ar, argv[1]);
+    audio_route_free(ar);
+
+    if (ret < 0) {
+        fprintf(stderr, "Unable to write %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
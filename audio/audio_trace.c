@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/atomic.h>
+
+#include "audio_trace.h"
+
+#define TRACE_RING_SIZE 1024 /* events per thread, must be a power of 2 */
+
+struct trace_entry {
+    int64_t time_ns; /* CLOCK_MONOTONIC */
+    int32_t event;
+    int32_t arg;
+};
+
+/*
+ * Only the owning thread writes to a ring: it fills the entry at head, then
+ * publishes it by incrementing head. Rings are never freed, the ring of an
+ * exited thread is handed to the next new thread.
+ */
+struct trace_ring {
+    struct trace_ring *next;
+    volatile int32_t in_use;
+    pid_t tid;
+    volatile int32_t head; /* events recorded, wraps around */
+    struct trace_entry entries[TRACE_RING_SIZE];
+};
+
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+/* protects the ring list, only taken on the first event of a thread and
+ * while dumping */
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_ring *rings;
+
+static void ring_release(void *data)
+{
+    struct trace_ring *ring = (struct trace_ring *)data;
+
+    android_atomic_release_store(0, &ring->in_use);
+}
+
+static void ring_key_create(void)
+{
+    pthread_key_create(&ring_key, ring_release);
+}
+
+static struct trace_ring *ring_get(void)
+{
+    struct trace_ring *ring;
+
+    pthread_once(&ring_key_once, ring_key_create);
+    ring = (struct trace_ring *)pthread_getspecific(ring_key);
+    if (ring)
+        return ring;
+
+    pthread_mutex_lock(&rings_lock);
+    for (ring = rings; ring; ring = ring->next)
+        if (!android_atomic_acquire_load(&ring->in_use))
+            break;
+    if (!ring) {
+        ring = (struct trace_ring *)calloc(1, sizeof(struct trace_ring));
+        if (!ring) {
+            pthread_mutex_unlock(&rings_lock);
+            return NULL;
+        }
+        ring->next = rings;
+        rings = ring;
+    }
+    ring->in_use = 1;
+    ring->tid = gettid();
+    ring->head = 0;
+    pthread_mutex_unlock(&rings_lock);
+
+    pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+void audio_trace_record(int event, int32_t arg)
+{
+    struct trace_ring *ring = ring_get();
+    struct trace_entry *entry;
+    struct timespec ts;
+    int32_t head;
+
+    if (!ring)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    head = ring->head;
+    entry = &ring->entries[(uint32_t)head & (TRACE_RING_SIZE - 1)];
+    entry->time_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    entry->event = event;
+    entry->arg = arg;
+    android_atomic_release_store(head + 1, &ring->head);
+}
+
+/* prints the events of one ring. Entries overwritten by the owner while
+ * they are copied are dropped */
+static void ring_dump(int fd, struct trace_ring *ring,
+                      struct trace_entry *entries)
+{
+    char buffer[128];
+    uint32_t head;
+    uint32_t end;
+    uint32_t first;
+    uint32_t i;
+    int len;
+
+    head = (uint32_t)android_atomic_acquire_load(&ring->head);
+    memcpy(entries, ring->entries, sizeof(ring->entries));
+    end = (uint32_t)android_atomic_release_load(&ring->head);
+
+    first = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+    if (end - first >= TRACE_RING_SIZE)
+        first = end - TRACE_RING_SIZE + 1;
+    if (first > head)
+        first = head;
+
+    len = snprintf(buffer, sizeof(buffer), "audio_trace thread %d: %u events\n",
+                   ring->tid, head - first);
+    write(fd, buffer, len);
+    for (i = first; i != head; i++) {
+        struct trace_entry *entry = &entries[i & (TRACE_RING_SIZE - 1)];
+
+        len = snprintf(buffer, sizeof(buffer), "T %d %lld %d %d\n", ring->tid,
+                       (long long)entry->time_ns, entry->event, entry->arg);
+        write(fd, buffer, len);
+    }
+}
+
+void audio_trace_dump(int fd)
+{
+    struct trace_entry *entries;
+    struct trace_ring *ring;
+
+    entries = (struct trace_entry *)malloc(sizeof(ring->entries));
+    if (!entries)
+        return;
+
+    pthread_mutex_lock(&rings_lock);
+    for (ring = rings; ring; ring = ring->next)
+        ring_dump(fd, ring, entries);
+    pthread_mutex_unlock(&rings_lock);
+
+    free(entries);
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_TRACE_H
+#define AUDIO_TRACE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+/* Event trace of the HAL hot paths, built in when AUDIO_HW_TRACE is defined.
+   Each thread records timestamped events into its own ring without locking,
+   and audio_trace_dump() prints the rings for audio_trace_decode to turn into
+   a timeline. Without AUDIO_HW_TRACE the macros below compile to nothing. */
+
+/* Events and the meaning of their argument. The values are part of the dump
+   format, new events go at the end */
+enum audio_trace_event {
+    AUDIO_TRACE_OUT_WRITE_BEGIN = 1,    /* bytes */
+    AUDIO_TRACE_OUT_WRITE_END,          /* bytes written, or error */
+    AUDIO_TRACE_IN_READ_BEGIN,          /* bytes */
+    AUDIO_TRACE_IN_READ_END,            /* bytes read, or error */
+    AUDIO_TRACE_PCM_OPEN,               /* PCM device */
+    AUDIO_TRACE_PCM_CLOSE,              /* 0 for output, 1 for input */
+    AUDIO_TRACE_PCM_WRITE_BEGIN,        /* frames */
+    AUDIO_TRACE_PCM_WRITE_END,          /* 0, or error */
+    AUDIO_TRACE_PCM_READ_BEGIN,         /* frames */
+    AUDIO_TRACE_PCM_READ_END,           /* 0, or error */
+    AUDIO_TRACE_PCM_WAIT_BEGIN,         /* timeout in ms */
+    AUDIO_TRACE_PCM_WAIT_END,           /* pcm_wait() result */
+    AUDIO_TRACE_SLEEP_BEGIN,            /* planned sleep in us */
+    AUDIO_TRACE_SLEEP_END,              /* 0 */
+    AUDIO_TRACE_LOCK_WAIT_BEGIN,        /* AUDIO_TRACE_LOCK_* */
+    AUDIO_TRACE_LOCK_WAIT_END,          /* AUDIO_TRACE_LOCK_* */
+    AUDIO_TRACE_XRUN,                   /* 0 for an underrun, 1 for an overrun */
+    AUDIO_TRACE_ROUTING,                /* output devices set by a stream */
+    AUDIO_TRACE_ROUTE_BEGIN,            /* output devices */
+    AUDIO_TRACE_ROUTE_END,              /* input devices */
+    AUDIO_TRACE_PATH_APPLY,             /* path handle */
+    AUDIO_TRACE_MIXER_COMMIT_BEGIN,     /* dirty ctls */
+    AUDIO_TRACE_MIXER_CTL,              /* index of a ctl written */
+    AUDIO_TRACE_MIXER_COMMIT_END,       /* ctls written */
+    AUDIO_TRACE_EVENT_COUNT,
+};
+
+/* locks whose contended waits are recorded */
+enum {
+    AUDIO_TRACE_LOCK_DEVICE,
+    AUDIO_TRACE_LOCK_OUT,
+    AUDIO_TRACE_LOCK_IN,
+    AUDIO_TRACE_LOCK_ROUTE,
+};
+
+#ifdef AUDIO_HW_TRACE
+
+/* Records an event in the ring of the calling thread */
+void audio_trace_record(int event, int32_t arg);
+
+/* Prints the events of all threads, oldest first in each thread */
+void audio_trace_dump(int fd);
+
+/* Locks the mutex, recording the wait only when it is contended */
+static inline void audio_trace_lock(pthread_mutex_t *lock, int32_t id)
+{
+    if (pthread_mutex_trylock(lock) == 0)
+        return;
+
+    audio_trace_record(AUDIO_TRACE_LOCK_WAIT_BEGIN, id);
+    pthread_mutex_lock(lock);
+    audio_trace_record(AUDIO_TRACE_LOCK_WAIT_END, id);
+}
+
+#define AUDIO_TRACE(event, arg) audio_trace_record(event, arg)
+#define AUDIO_TRACE_LOCK(lock, id) audio_trace_lock(lock, id)
+#define AUDIO_TRACE_DUMP(fd) audio_trace_dump(fd)
+
+#else
+
+#define AUDIO_TRACE(event, arg) do { } while (0)
+#define AUDIO_TRACE_LOCK(lock, id) pthread_mutex_lock(lock)
+#define AUDIO_TRACE_DUMP(fd) do { } while (0)
+
+#endif
+
+#endif
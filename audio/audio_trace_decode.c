@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host tool turning the audio_trace lines of a dump, for instance
+ * "adb shell dumpsys media.audio_flinger", into a timeline of all threads.
+ * The end of each begin/end pair shows how long the pair lasted.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_trace.h"
+
+struct event {
+    int64_t time_ns;
+    int tid;
+    int id;
+    int arg;
+};
+
+/* pending begin events of a thread */
+struct thread {
+    int tid;
+    int64_t begin_ns[AUDIO_TRACE_EVENT_COUNT];
+};
+
+static const char * const event_names[AUDIO_TRACE_EVENT_COUNT] = {
+    [AUDIO_TRACE_OUT_WRITE_BEGIN] = "out_write",
+    [AUDIO_TRACE_OUT_WRITE_END] = "out_write done",
+    [AUDIO_TRACE_IN_READ_BEGIN] = "in_read",
+    [AUDIO_TRACE_IN_READ_END] = "in_read done",
+    [AUDIO_TRACE_PCM_OPEN] = "pcm open",
+    [AUDIO_TRACE_PCM_CLOSE] = "pcm close",
+    [AUDIO_TRACE_PCM_WRITE_BEGIN] = "pcm write",
+    [AUDIO_TRACE_PCM_WRITE_END] = "pcm write done",
+    [AUDIO_TRACE_PCM_READ_BEGIN] = "pcm read",
+    [AUDIO_TRACE_PCM_READ_END] = "pcm read done",
+    [AUDIO_TRACE_PCM_WAIT_BEGIN] = "pcm wait",
+    [AUDIO_TRACE_PCM_WAIT_END] = "pcm wait done",
+    [AUDIO_TRACE_SLEEP_BEGIN] = "sleep",
+    [AUDIO_TRACE_SLEEP_END] = "sleep done",
+    [AUDIO_TRACE_LOCK_WAIT_BEGIN] = "lock wait",
+    [AUDIO_TRACE_LOCK_WAIT_END] = "lock acquired",
+    [AUDIO_TRACE_XRUN] = "XRUN",
+    [AUDIO_TRACE_ROUTING] = "routing",
+    [AUDIO_TRACE_ROUTE_BEGIN] = "route",
+    [AUDIO_TRACE_ROUTE_END] = "route done",
+    [AUDIO_TRACE_PATH_APPLY] = "path apply",
+    [AUDIO_TRACE_MIXER_COMMIT_BEGIN] = "mixer commit",
+    [AUDIO_TRACE_MIXER_CTL] = "mixer ctl",
+    [AUDIO_TRACE_MIXER_COMMIT_END] = "mixer commit done",
+};
+
+/* the begin event matching each end event */
+static const int event_begin[AUDIO_TRACE_EVENT_COUNT] = {
+    [AUDIO_TRACE_OUT_WRITE_END] = AUDIO_TRACE_OUT_WRITE_BEGIN,
+    [AUDIO_TRACE_IN_READ_END] = AUDIO_TRACE_IN_READ_BEGIN,
+    [AUDIO_TRACE_PCM_WRITE_END] = AUDIO_TRACE_PCM_WRITE_BEGIN,
+    [AUDIO_TRACE_PCM_READ_END] = AUDIO_TRACE_PCM_READ_BEGIN,
+    [AUDIO_TRACE_PCM_WAIT_END] = AUDIO_TRACE_PCM_WAIT_BEGIN,
+    [AUDIO_TRACE_SLEEP_END] = AUDIO_TRACE_SLEEP_BEGIN,
+    [AUDIO_TRACE_LOCK_WAIT_END] = AUDIO_TRACE_LOCK_WAIT_BEGIN,
+    [AUDIO_TRACE_ROUTE_END] = AUDIO_TRACE_ROUTE_BEGIN,
+    [AUDIO_TRACE_MIXER_COMMIT_END] = AUDIO_TRACE_MIXER_COMMIT_BEGIN,
+};
+
+static int compare_events(const void *a, const void *b)
+{
+    const struct event *ea = (const struct event *)a;
+    const struct event *eb = (const struct event *)b;
+
+    if (ea->time_ns != eb->time_ns)
+        return (ea->time_ns < eb->time_ns) ? -1 : 1;
+    return 0;
+}
+
+static struct thread *get_thread(struct thread **threads,
+                                 unsigned int *num_threads, int tid)
+{
+    struct thread *thread;
+    unsigned int i;
+
+    for (i = 0; i < *num_threads; i++)
+        if ((*threads)[i].tid == tid)
+            return &(*threads)[i];
+
+    thread = realloc(*threads, (*num_threads + 1) * sizeof(struct thread));
+    if (!thread)
+        return NULL;
+    *threads = thread;
+    thread = &(*threads)[(*num_threads)++];
+    memset(thread, 0, sizeof(*thread));
+    thread->tid = tid;
+
+    return thread;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *file = stdin;
+    char line[256];
+    struct event *events = NULL;
+    unsigned int num_events = 0;
+    unsigned int size = 0;
+    struct thread *threads = NULL;
+    unsigned int num_threads = 0;
+    unsigned int i;
+
+    if (argc > 2) {
+        fprintf(stderr, "Usage: %s [dump file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) {
+        file = fopen(argv[1], "r");
+        if (!file) {
+            fprintf(stderr, "Unable to open %s\n", argv[1]);
+            return 1;
+        }
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        struct event event;
+        long long time_ns;
+
+        if (sscanf(line, "T %d %lld %d %d", &event.tid, &time_ns,
+                   &event.id, &event.arg) != 4)
+            continue;
+        if (event.id <= 0 || event.id >= AUDIO_TRACE_EVENT_COUNT)
+            continue;
+        event.time_ns = time_ns;
+
+        if (num_events == size) {
+            struct event *new_events;
+
+            size = size ? size * 2 : 1024;
+            new_events = realloc(events, size * sizeof(struct event));
+            if (!new_events) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+            events = new_events;
+        }
+        events[num_events++] = event;
+    }
+    if (file != stdin)
+        fclose(file);
+
+    if (num_events == 0) {
+        fprintf(stderr, "No audio_trace events found\n");
+        return 1;
+    }
+
+    qsort(events, num_events, sizeof(struct event), compare_events);
+
+    printf("%12s %6s  %-18s %10s %10s\n", "time (ms)", "tid", "event", "arg",
+           "took (ms)");
+    for (i = 0; i < num_events; i++) {
+        struct event *event = &events[i];
+        struct thread *thread = get_thread(&threads, &num_threads, event->tid);
+        int begin = event_begin[event->id];
+
+        printf("%12.3f %6d  %-18s %10d", (event->time_ns - events[0].time_ns) /
+               1000000.0, event->tid, event_names[event->id], event->arg);
+        if (thread && begin && thread->begin_ns[begin]) {
+            printf(" %10.3f", (event->time_ns - thread->begin_ns[begin]) /
+                   1000000.0);
+            thread->begin_ns[begin] = 0;
+        } else if (thread) {
+            thread->begin_ns[event->id] = event->time_ns;
+        }
+        printf("\n");
+    }
+
+    free(threads);
+    free(events);
+    return 0;
+}
@@ -0,0 +1,277 @@
+# Copyright (C) 2026 agent <agent@local>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# The tests link the HAL against fake_tinyalsa.c instead of libtinyalsa, so
+# they run on any device without touching its sound card. They are target
+# executables because libaudioutils, which the HAL resamples with, has no
+# host build. Run them from /data/local/tmp, where the route cache goes.
+# audio_hal_bench is also built for the host, with fake_host.c standing in
+# for libaudioutils and bionic's gettid().
+
+LOCAL_PATH := $(call my-dir)
+
+audio_test_cflags := \
+	-Dproperty_get=fake_property_get \
+	-Dclock_nanosleep=fake_clock_nanosleep \
+	-DMIXER_CACHE_PATH=\"/data/local/tmp/mixer_paths.cache\"
+ifeq ($(TINYALSA_CTL_ARRAY),true)
+audio_test_cflags += -DMIXER_CTL_ARRAY
+endif
+
+audio_test_hal_src_files := \
+	../audio_hw.c \
+	../audio_convert.c \
+	../audio_ring.c \
+	../audio_route.c \
+	fake_tinyalsa.c \
+	audio_test.c \
+	audio_test_hal.c
+
+audio_test_c_includes := \
+	$(LOCAL_PATH)/.. \
+	external/tinyalsa/include \
+	external/expat/lib \
+	$(call include-path-for, audio-utils)
+
+audio_test_shared_libraries := liblog libcutils libaudioutils libexpat
+
+# the route tests generate their own mixer paths XML
+audio_test_route_src_files := \
+	../audio_route.c \
+	fake_tinyalsa.c \
+	audio_test.c
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_latency_test
+
+LOCAL_SRC_FILES := \
+	audio_latency_test.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_route_storm_test
+
+LOCAL_SRC_FILES := \
+	audio_route_storm_test.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_contention_bench
+
+LOCAL_SRC_FILES := \
+	audio_contention_bench.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_pacing_test
+
+LOCAL_SRC_FILES := \
+	audio_pacing_test.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_rate_test
+
+LOCAL_SRC_FILES := \
+	audio_rate_test.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_resampler_bench
+
+LOCAL_SRC_FILES := \
+	audio_resampler_bench.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_mmap_test
+
+LOCAL_SRC_FILES := \
+	audio_mmap_test.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_route_apply_bench
+
+LOCAL_SRC_FILES := \
+	audio_route_apply_bench.c \
+	$(audio_test_route_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := liblog libcutils libexpat
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags) \
+	-DMIXER_XML_PATH=\"/data/local/tmp/audio_route_apply_bench.xml\" \
+	-DFAKE_MIXER_XML_PATH=\"/data/local/tmp/audio_route_apply_bench.xml\"
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_route_init_bench
+
+LOCAL_SRC_FILES := \
+	audio_route_init_bench.c \
+	$(audio_test_route_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := liblog libcutils libexpat
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags) \
+	-DMIXER_XML_PATH=\"/data/local/tmp/audio_route_init_bench.xml\" \
+	-DFAKE_MIXER_XML_PATH=\"/data/local/tmp/audio_route_init_bench.xml\"
+
+include $(BUILD_EXECUTABLE)
+
+# the host build checks the portable loops, the target one the NEON ones
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_convert_test
+
+LOCAL_SRC_FILES := \
+	audio_convert_test.c \
+	../audio_convert.c
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_convert_test
+
+LOCAL_SRC_FILES := \
+	audio_convert_test.c \
+	../audio_convert.c
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+# -fno-tree-vectorize keeps the reference loops of the benchmark scalar, the
+# NEON blocks of the kernels are intrinsics and are not affected
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_convert_bench
+
+LOCAL_SRC_FILES := \
+	audio_convert_bench.c \
+	../audio_convert.c
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_CFLAGS += -fno-tree-vectorize
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_convert_bench
+
+LOCAL_SRC_FILES := \
+	audio_convert_bench.c \
+	../audio_convert.c
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_CFLAGS += -fno-tree-vectorize
+LOCAL_MODULE_TAGS := tests
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_hal_bench
+
+LOCAL_SRC_FILES := \
+	audio_hal_bench.c \
+	$(audio_test_hal_src_files)
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_SHARED_LIBRARIES := $(audio_test_shared_libraries)
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += $(audio_test_cflags)
+
+include $(BUILD_EXECUTABLE)
+
+# the host build reads the board mixer paths XML from the source tree
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := audio_hal_bench
+
+LOCAL_SRC_FILES := \
+	audio_hal_bench.c \
+	$(audio_test_hal_src_files) \
+	fake_host.c
+LOCAL_C_INCLUDES += $(audio_test_c_includes)
+LOCAL_STATIC_LIBRARIES := liblog libcutils libexpat
+LOCAL_LDLIBS += -lpthread -lrt -lm
+LOCAL_MODULE_TAGS := tests
+LOCAL_CFLAGS += \
+	-Dproperty_get=fake_property_get \
+	-Dclock_nanosleep=fake_clock_nanosleep \
+	-Dgettid=fake_gettid \
+	-include $(LOCAL_PATH)/fake_tinyalsa.h \
+	-DMIXER_XML_PATH=\"$(abspath $(LOCAL_PATH)/../../mixer_paths.xml)\" \
+	-DFAKE_MIXER_XML_PATH=\"$(abspath $(LOCAL_PATH)/../../mixer_paths.xml)\" \
+	-DMIXER_CACHE_PATH=\"/tmp/audio_hal_bench.cache\"
+ifeq ($(TINYALSA_CTL_ARRAY),true)
+LOCAL_CFLAGS += -DMIXER_CTL_ARRAY
+endif
+
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs a writer, a reader and a thread spamming parameter calls at once,
+ * and reports how long the writes and reads take, first without and then
+ * with the parameter traffic. The data path only takes the stream locks
+ * in steady state, so the parameter calls must not lengthen the writes or
+ * the reads, nor make either stream lose data. The parameter thread also
+ * polls the render position, which must not wait for the writer and must
+ * never go back, and which restarts from 0 after standby.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define RUN_SECONDS 1.0
+/* a call may block for its own buffer, plus this much */
+#define MAX_CALL_SLACK_MS 10
+/* the position getters do not take the stream mutex */
+#define MAX_POSITION_CALL_MS 2
+
+struct call_stats {
+    unsigned int calls;
+    int64_t total_ns;
+    int64_t max_ns;
+};
+
+struct contention {
+    struct audio_hw_device *dev;
+    struct audio_stream_out *out;
+    struct audio_stream_in *in;
+    volatile bool stop;
+    struct call_stats read;
+    struct call_stats params;
+    struct call_stats position;
+    uint32_t last_position;
+    bool position_went_back;
+};
+
+static void call_stats_add(struct call_stats *stats, int64_t start)
+{
+    int64_t elapsed = fake_now_ns() - start;
+
+    stats->calls++;
+    stats->total_ns += elapsed;
+    if (elapsed > stats->max_ns)
+        stats->max_ns = elapsed;
+}
+
+static void *reader_thread(void *context)
+{
+    struct contention *contention = (struct contention *)context;
+    struct audio_stream_in *in = contention->in;
+    size_t bytes = in->common.get_buffer_size(&in->common);
+    void *buffer = malloc(bytes);
+    int64_t start;
+
+    while (buffer && !contention->stop) {
+        start = fake_now_ns();
+        if (!TEST_CHECK(in->read(in, buffer, bytes) == (ssize_t)bytes))
+            break;
+        call_stats_add(&contention->read, start);
+    }
+    free(buffer);
+    return NULL;
+}
+
+static void *params_thread(void *context)
+{
+    struct contention *contention = (struct contention *)context;
+    struct audio_hw_device *dev = contention->dev;
+    struct audio_stream_out *out = contention->out;
+    unsigned int i = 0;
+    int64_t start;
+    char *value;
+    uint32_t position;
+    int64_t timestamp;
+
+    while (!contention->stop) {
+        start = fake_now_ns();
+        dev->set_parameters(dev, (i & 1) ? "screen_state=off" :
+                            "screen_state=on");
+        dev->set_parameters(dev, (i & 2) ? "orientation=landscape" :
+                            "orientation=portrait");
+        value = out->common.get_parameters(&out->common, "routing");
+        free(value);
+        call_stats_add(&contention->params, start);
+
+        start = fake_now_ns();
+        out->get_render_position(out, &position);
+        out->get_next_write_timestamp(out, &timestamp);
+        call_stats_add(&contention->position, start);
+        if (position < contention->last_position)
+            contention->position_went_back = true;
+        contention->last_position = position;
+        i++;
+    }
+    return NULL;
+}
+
+/* plays for RUN_SECONDS with the reader running, and the parameter thread
+ * too if params is true. Returns the longest write. */
+static int64_t run(struct contention *contention, bool params)
+{
+    pthread_t reader;
+    pthread_t spammer;
+    int64_t max_write_ns;
+
+    contention->stop = false;
+    memset(&contention->read, 0, sizeof(contention->read));
+    memset(&contention->params, 0, sizeof(contention->params));
+    memset(&contention->position, 0, sizeof(contention->position));
+    fake_reset();
+
+    pthread_create(&reader, NULL, reader_thread, contention);
+    if (params)
+        pthread_create(&spammer, NULL, params_thread, contention);
+    max_write_ns = test_play(contention->out, 1000, RUN_SECONDS);
+    contention->stop = true;
+    pthread_join(reader, NULL);
+    if (params)
+        pthread_join(spammer, NULL);
+
+    printf("%-12s max write %5.1f ms, reads %5.2f/%5.1f ms mean/max, "
+           "%u xruns", params ? "params:" : "no params:",
+           max_write_ns / 1000000.0,
+           contention->read.calls ? contention->read.total_ns / 1000000.0 /
+                   contention->read.calls : 0.0,
+           contention->read.max_ns / 1000000.0, fake_stats.xruns);
+    if (params)
+        printf(", %u parameter rounds, %.3f ms mean, position %.3f ms max",
+               contention->params.calls, contention->params.calls ?
+                       contention->params.total_ns / 1000000.0 /
+                               contention->params.calls : 0.0,
+               contention->position.max_ns / 1000000.0);
+    printf("\n");
+    return max_write_ns;
+}
+
+int main(int argc, char **argv)
+{
+    struct contention contention;
+    uint32_t out_buffer_ms;
+    uint32_t in_buffer_ms;
+    int64_t max_write_ns;
+    uint32_t position;
+
+    memset(&contention, 0, sizeof(contention));
+    contention.dev = test_open_device();
+    contention.out = test_open_output(contention.dev,
+                                      AUDIO_OUTPUT_FLAG_PRIMARY, 44100,
+                                      AUDIO_CHANNEL_OUT_STEREO);
+    contention.in = test_open_input(contention.dev,
+                                    AUDIO_DEVICE_IN_BUILTIN_MIC, 44100,
+                                    AUDIO_CHANNEL_IN_MONO);
+    out_buffer_ms = contention.out->common.get_buffer_size(
+            &contention.out->common) * 1000 /
+            audio_stream_frame_size(&contention.out->common) / 44100;
+    in_buffer_ms = contention.in->common.get_buffer_size(
+            &contention.in->common) * 1000 /
+            audio_stream_frame_size(&contention.in->common) / 44100;
+
+    /* start both streams before timing */
+    test_play(contention.out, 1000, 0.1);
+
+    run(&contention, false);
+    max_write_ns = run(&contention, true);
+    TEST_CHECK(contention.params.calls > 0);
+    TEST_CHECK(max_write_ns <
+               (out_buffer_ms + MAX_CALL_SLACK_MS) * 1000000LL);
+    TEST_CHECK(contention.read.max_ns <
+               (in_buffer_ms + MAX_CALL_SLACK_MS) * 1000000LL);
+    TEST_CHECK(fake_stats.xruns == 0);
+    TEST_CHECK(contention.position.max_ns <
+               MAX_POSITION_CALL_MS * 1000000LL);
+    TEST_CHECK(!contention.position_went_back);
+
+    contention.out->common.standby(&contention.out->common);
+    test_play(contention.out, 1000, 0.1);
+    contention.out->get_render_position(contention.out, &position);
+    TEST_CHECK(position < contention.last_position);
+
+    contention.dev->close_input_stream(contention.dev, contention.in);
+    contention.dev->close_output_stream(contention.dev, contention.out);
+    test_close_device(contention.dev);
+
+    return test_result();
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times each kernel of audio_convert.c against the plain C loop it
+ * replaces, on buffers of one output period, and checks that both give the
+ * same samples. On the target the kernels run their NEON blocks, on the
+ * host their portable loops, so there both columns should be close. The
+ * module is built with -fno-tree-vectorize so that the reference loops
+ * stay scalar.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_convert.h"
+
+#define BENCH_FRAMES 800 /* OUT_PERIOD_SIZE */
+#define RUNS 20000
+
+struct buffers {
+    int16_t s16[BENCH_FRAMES * 2];
+    int32_t s32[BENCH_FRAMES * 2];
+    float f[BENCH_FRAMES * 2];
+    int16_t left[BENCH_FRAMES];
+    int16_t right[BENCH_FRAMES];
+    union {
+        int16_t s16[BENCH_FRAMES * 2];
+        int32_t s32[BENCH_FRAMES * 2];
+        float f[BENCH_FRAMES * 2];
+    } dst;
+};
+
+struct kernel {
+    const char *name;
+    void (*kernel)(struct buffers *b);
+    void (*reference)(struct buffers *b);
+    size_t dst_size; /* bytes of b->dst compared */
+};
+
+static unsigned int failures;
+
+static void extract_channel(struct buffers *b)
+{
+    audio_extract_channel_s16(b->dst.s16, b->s16, BENCH_FRAMES, 1);
+}
+
+static void extract_channel_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++)
+        b->dst.s16[i] = b->s16[i * 2 + 1];
+}
+
+static void deinterleave(struct buffers *b)
+{
+    audio_deinterleave_s16(b->left, b->right, b->s16, BENCH_FRAMES);
+    memcpy(b->dst.s16, b->left, sizeof(b->left));
+    memcpy(b->dst.s16 + BENCH_FRAMES, b->right, sizeof(b->right));
+}
+
+static void deinterleave_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        b->left[i] = b->s16[i * 2];
+        b->right[i] = b->s16[i * 2 + 1];
+    }
+    memcpy(b->dst.s16, b->left, sizeof(b->left));
+    memcpy(b->dst.s16 + BENCH_FRAMES, b->right, sizeof(b->right));
+}
+
+static void downmix(struct buffers *b)
+{
+    audio_downmix_s16(b->dst.s16, b->s16, BENCH_FRAMES);
+}
+
+static void downmix_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++)
+        b->dst.s16[i] = (int16_t)(((int32_t)b->s16[i * 2] +
+                                   b->s16[i * 2 + 1]) >> 1);
+}
+
+static void downmix_weighted(struct buffers *b)
+{
+    audio_downmix_weighted_s16(b->dst.s16, b->s16, BENCH_FRAMES, 20000,
+                               12767);
+}
+
+static void downmix_weighted_ref(struct buffers *b)
+{
+    int32_t sample;
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        sample = ((int32_t)b->s16[i * 2] * 20000 +
+                  (int32_t)b->s16[i * 2 + 1] * 12767) >> 15;
+        if (sample > 32767)
+            sample = 32767;
+        else if (sample < -32768)
+            sample = -32768;
+        b->dst.s16[i] = (int16_t)sample;
+    }
+}
+
+static void mono_to_stereo(struct buffers *b)
+{
+    audio_mono_to_stereo_s16(b->dst.s16, b->s16, BENCH_FRAMES);
+}
+
+static void mono_to_stereo_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES; i++) {
+        b->dst.s16[i * 2] = b->s16[i];
+        b->dst.s16[i * 2 + 1] = b->s16[i];
+    }
+}
+
+static void s16_to_s32(struct buffers *b)
+{
+    audio_s16_to_s32(b->dst.s32, b->s16, BENCH_FRAMES * 2);
+}
+
+static void s16_to_s32_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES * 2; i++)
+        b->dst.s32[i] = (int32_t)b->s16[i] * 65536;
+}
+
+static void s32_to_s16(struct buffers *b)
+{
+    audio_s32_to_s16(b->dst.s16, b->s32, BENCH_FRAMES * 2);
+}
+
+static void s32_to_s16_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES * 2; i++)
+        b->dst.s16[i] = (int16_t)(b->s32[i] >> 16);
+}
+
+static void s16_to_float(struct buffers *b)
+{
+    audio_s16_to_float(b->dst.f, b->s16, BENCH_FRAMES * 2);
+}
+
+static void s16_to_float_ref(struct buffers *b)
+{
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES * 2; i++)
+        b->dst.f[i] = b->s16[i] * (1.0f / 32768.0f);
+}
+
+static void float_to_s16(struct buffers *b)
+{
+    audio_float_to_s16(b->dst.s16, b->f, BENCH_FRAMES * 2);
+}
+
+static void float_to_s16_ref(struct buffers *b)
+{
+    float x;
+    size_t i;
+
+    for (i = 0; i < BENCH_FRAMES * 2; i++) {
+        x = b->f[i] * 32768.0f;
+        if (x != x)
+            b->dst.s16[i] = 0;
+        else if (x >= 32767.0f)
+            b->dst.s16[i] = 32767;
+        else if (x <= -32768.0f)
+            b->dst.s16[i] = -32768;
+        else
+            b->dst.s16[i] = (int16_t)(int32_t)x;
+    }
+}
+
+static const struct kernel kernels[] = {
+    { "extract_channel", extract_channel, extract_channel_ref,
+      BENCH_FRAMES * sizeof(int16_t) },
+    { "deinterleave", deinterleave, deinterleave_ref,
+      BENCH_FRAMES * 2 * sizeof(int16_t) },
+    { "downmix", downmix, downmix_ref, BENCH_FRAMES * sizeof(int16_t) },
+    { "downmix_weighted", downmix_weighted, downmix_weighted_ref,
+      BENCH_FRAMES * sizeof(int16_t) },
+    { "mono_to_stereo", mono_to_stereo, mono_to_stereo_ref,
+      BENCH_FRAMES * 2 * sizeof(int16_t) },
+    { "s16_to_s32", s16_to_s32, s16_to_s32_ref,
+      BENCH_FRAMES * 2 * sizeof(int32_t) },
+    { "s32_to_s16", s32_to_s16, s32_to_s16_ref,
+      BENCH_FRAMES * 2 * sizeof(int16_t) },
+    { "s16_to_float", s16_to_float, s16_to_float_ref,
+      BENCH_FRAMES * 2 * sizeof(float) },
+    { "float_to_s16", float_to_s16, float_to_s16_ref,
+      BENCH_FRAMES * 2 * sizeof(int16_t) },
+};
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* mean ns per frame of RUNS calls of fn */
+static double bench(void (*fn)(struct buffers *b), struct buffers *b)
+{
+    int64_t start = cpu_ns();
+    unsigned int run;
+
+    for (run = 0; run < RUNS; run++)
+        fn(b);
+
+    return (double)(cpu_ns() - start) / RUNS / BENCH_FRAMES;
+}
+
+int main(int argc, char **argv)
+{
+    static struct buffers b;
+    unsigned char expected[sizeof(b.dst)];
+    double kernel_ns;
+    double reference_ns;
+    unsigned int i;
+
+    srand(1);
+    for (i = 0; i < BENCH_FRAMES * 2; i++) {
+        b.s16[i] = (int16_t)rand();
+        b.s32[i] = (int32_t)(((uint32_t)rand() << 16) ^ rand());
+        b.f[i] = (rand() % 65536 - 32768) / 32768.0f;
+    }
+
+#ifdef __ARM_NEON__
+    printf("NEON kernels against scalar loops, %d frames\n", BENCH_FRAMES);
+#else
+    printf("portable kernels against scalar loops, %d frames\n",
+           BENCH_FRAMES);
+#endif
+    for (i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++) {
+        kernels[i].reference(&b);
+        memcpy(expected, &b.dst, kernels[i].dst_size);
+        memset(&b.dst, 0, sizeof(b.dst));
+        kernels[i].kernel(&b);
+        if (memcmp(expected, &b.dst, kernels[i].dst_size) != 0) {
+            printf("FAIL %s differs from its scalar loop\n", kernels[i].name);
+            failures++;
+        }
+
+        kernel_ns = bench(kernels[i].kernel, &b);
+        reference_ns = bench(kernels[i].reference, &b);
+        printf("%-17s %6.3f ns/frame, scalar %6.3f ns/frame, x%.2f\n",
+               kernels[i].name, kernel_ns, reference_ns,
+               kernel_ns > 0 ? reference_ns / kernel_ns : 0.0);
+    }
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
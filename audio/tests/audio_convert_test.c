@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Checks the kernels of audio_convert.c against plain C references, on
+ * every length up to MAX_FRAMES so that both the NEON blocks and the tails
+ * run, in place where the kernel allows it. Built for the host, which runs
+ * the portable loops, and for the target, which runs the NEON ones.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio_convert.h"
+
+#define MAX_FRAMES 40
+#define ROUNDS 100
+
+static unsigned int failures;
+
+static int16_t clamp_s16(int32_t sample)
+{
+    if (sample > 32767)
+        return 32767;
+    if (sample < -32768)
+        return -32768;
+    return (int16_t)sample;
+}
+
+/* random samples, with the extremes more often than chance would give */
+static void fill(int16_t *buffer, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        switch (rand() % 8) {
+        case 0:
+            buffer[i] = 32767;
+            break;
+        case 1:
+            buffer[i] = -32768;
+            break;
+        default:
+            buffer[i] = (int16_t)rand();
+            break;
+        }
+    }
+}
+
+/* random floats around [-1.0, 1.0), some out of range and some NaN */
+static void fill_float(float *buffer, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        switch (rand() % 16) {
+        case 0:
+            buffer[i] = 0.0f / 0.0f;
+            break;
+        case 1:
+            buffer[i] = (rand() & 1) ? 1.0f : -1.0f;
+            break;
+        case 2:
+            buffer[i] = (rand() % 1000 - 500) * 0.01f;
+            break;
+        default:
+            buffer[i] = (rand() % 65536 - 32768) / 32768.0f +
+                    (rand() % 100) / 3276800.0f;
+            break;
+        }
+    }
+}
+
+static void compare(const char *name, const int16_t *result,
+                    const int16_t *expected, size_t count, size_t frames)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (result[i] != expected[i]) {
+            printf("FAIL %s, %zu frames: sample %zu is %d, expected %d\n",
+                   name, frames, i, result[i], expected[i]);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void compare_s32(const char *name, const int32_t *result,
+                        const int32_t *expected, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (result[i] != expected[i]) {
+            printf("FAIL %s, %zu samples: sample %zu is %d, expected %d\n",
+                   name, count, i, result[i], expected[i]);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void compare_float(const char *name, const float *result,
+                          const float *expected, size_t count)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++) {
+        if (result[i] != expected[i]) {
+            printf("FAIL %s, %zu samples: sample %zu is %f, expected %f\n",
+                   name, count, i, result[i], expected[i]);
+            failures++;
+            return;
+        }
+    }
+}
+
+static void test_extract_channel(size_t frames)
+{
+    int16_t src[MAX_FRAMES * 2];
+    int16_t dst[MAX_FRAMES * 2];
+    int16_t expected[MAX_FRAMES];
+    unsigned int channel;
+    size_t i;
+
+    fill(src, frames * 2);
+    for (channel = 0; channel < 2; channel++) {
+        for (i = 0; i < frames; i++)
+            expected[i] = src[i * 2 + channel];
+        audio_extract_channel_s16(dst, src, frames, channel);
+        compare("extract_channel", dst, expected, frames, frames);
+
+        memcpy(dst, src, sizeof(src));
+        audio_extract_channel_s16(dst, dst, frames, channel);
+        compare("extract_channel in place", dst, expected, frames, frames);
+    }
+}
+
+static void test_deinterleave(size_t frames)
+{
+    int16_t src[MAX_FRAMES * 2];
+    int16_t left[MAX_FRAMES];
+    int16_t right[MAX_FRAMES];
+    int16_t expected_left[MAX_FRAMES];
+    int16_t expected_right[MAX_FRAMES];
+    size_t i;
+
+    fill(src, frames * 2);
+    for (i = 0; i < frames; i++) {
+        expected_left[i] = src[i * 2];
+        expected_right[i] = src[i * 2 + 1];
+    }
+    audio_deinterleave_s16(left, right, src, frames);
+    compare("deinterleave left", left, expected_left, frames, frames);
+    compare("deinterleave right", right, expected_right, frames, frames);
+}
+
+static void test_downmix(size_t frames)
+{
+    int16_t src[MAX_FRAMES * 2];
+    int16_t dst[MAX_FRAMES * 2];
+    int16_t expected[MAX_FRAMES];
+    size_t i;
+
+    fill(src, frames * 2);
+    for (i = 0; i < frames; i++)
+        expected[i] = (int16_t)(((int32_t)src[i * 2] + src[i * 2 + 1]) >> 1);
+    audio_downmix_s16(dst, src, frames);
+    compare("downmix", dst, expected, frames, frames);
+
+    memcpy(dst, src, sizeof(src));
+    audio_downmix_s16(dst, dst, frames);
+    compare("downmix in place", dst, expected, frames, frames);
+}
+
+static void test_downmix_weighted(size_t frames)
+{
+    int16_t src[MAX_FRAMES * 2];
+    int16_t dst[MAX_FRAMES * 2];
+    int16_t expected[MAX_FRAMES];
+    int16_t left_weight = rand() & 0x7fff;
+    int16_t right_weight = rand() & 0x7fff;
+    size_t i;
+
+    fill(src, frames * 2);
+    for (i = 0; i < frames; i++)
+        expected[i] = clamp_s16(((int32_t)src[i * 2] * left_weight +
+                                 (int32_t)src[i * 2 + 1] * right_weight) >>
+                                15);
+    audio_downmix_weighted_s16(dst, src, frames, left_weight, right_weight);
+    compare("downmix_weighted", dst, expected, frames, frames);
+
+    memcpy(dst, src, sizeof(src));
+    audio_downmix_weighted_s16(dst, dst, frames, left_weight, right_weight);
+    compare("downmix_weighted in place", dst, expected, frames, frames);
+}
+
+static void test_mono_to_stereo(size_t frames)
+{
+    int16_t src[MAX_FRAMES];
+    int16_t dst[MAX_FRAMES * 2];
+    int16_t expected[MAX_FRAMES * 2];
+    size_t i;
+
+    fill(src, frames);
+    for (i = 0; i < frames; i++) {
+        expected[i * 2] = src[i];
+        expected[i * 2 + 1] = src[i];
+    }
+    audio_mono_to_stereo_s16(dst, src, frames);
+    compare("mono_to_stereo", dst, expected, frames * 2, frames);
+
+    /* in place, from the second half of dst */
+    memcpy(dst + frames, src, frames * sizeof(int16_t));
+    audio_mono_to_stereo_s16(dst, dst + frames, frames);
+    compare("mono_to_stereo in place", dst, expected, frames * 2, frames);
+}
+
+static void test_s16_to_s32(size_t count)
+{
+    int16_t src[MAX_FRAMES];
+    int32_t dst[MAX_FRAMES];
+    int32_t expected[MAX_FRAMES];
+    size_t i;
+
+    fill(src, count);
+    for (i = 0; i < count; i++)
+        expected[i] = (int32_t)src[i] * 65536;
+    audio_s16_to_s32(dst, src, count);
+    compare_s32("s16_to_s32", dst, expected, count);
+}
+
+static void test_s32_to_s16(size_t count)
+{
+    union {
+        int32_t s32[MAX_FRAMES];
+        int16_t s16[MAX_FRAMES * 2];
+    } buffer;
+    int32_t src[MAX_FRAMES];
+    int16_t dst[MAX_FRAMES];
+    int16_t expected[MAX_FRAMES];
+    size_t i;
+
+    for (i = 0; i < count; i++)
+        src[i] = (int32_t)(((uint32_t)rand() << 16) ^ rand());
+    for (i = 0; i < count; i++)
+        expected[i] = (int16_t)(src[i] >> 16);
+    audio_s32_to_s16(dst, src, count);
+    compare("s32_to_s16", dst, expected, count, count);
+
+    memcpy(buffer.s32, src, count * sizeof(int32_t));
+    audio_s32_to_s16(buffer.s16, buffer.s32, count);
+    compare("s32_to_s16 in place", buffer.s16, expected, count, count);
+}
+
+static void test_s16_to_float(size_t count)
+{
+    int16_t src[MAX_FRAMES];
+    float dst[MAX_FRAMES];
+    float expected[MAX_FRAMES];
+    size_t i;
+
+    fill(src, count);
+    for (i = 0; i < count; i++)
+        expected[i] = src[i] / 32768.0f;
+    audio_s16_to_float(dst, src, count);
+    compare_float("s16_to_float", dst, expected, count);
+}
+
+static void test_float_to_s16(size_t count)
+{
+    union {
+        float f[MAX_FRAMES];
+        int16_t s16[MAX_FRAMES * 2];
+    } buffer;
+    float src[MAX_FRAMES];
+    int16_t dst[MAX_FRAMES];
+    int16_t expected[MAX_FRAMES];
+    double x;
+    size_t i;
+
+    fill_float(src, count);
+    for (i = 0; i < count; i++) {
+        /* scaled exactly, then clamped and truncated towards zero */
+        x = src[i] * 32768.0;
+        if (x != x)
+            expected[i] = 0;
+        else if (x >= 32767.0)
+            expected[i] = 32767;
+        else if (x <= -32768.0)
+            expected[i] = -32768;
+        else
+            expected[i] = (int16_t)(int32_t)x;
+    }
+    audio_float_to_s16(dst, src, count);
+    compare("float_to_s16", dst, expected, count, count);
+
+    memcpy(buffer.f, src, count * sizeof(float));
+    audio_float_to_s16(buffer.s16, buffer.f, count);
+    compare("float_to_s16 in place", buffer.s16, expected, count, count);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int round;
+    size_t frames;
+
+    srand(1);
+    for (round = 0; round < ROUNDS; round++) {
+        for (frames = 0; frames <= MAX_FRAMES; frames++) {
+            test_extract_channel(frames);
+            test_deinterleave(frames);
+            test_downmix(frames);
+            test_downmix_weighted(frames);
+            test_mono_to_stereo(frames);
+            test_s16_to_s32(frames);
+            test_s32_to_s16(frames);
+            test_s16_to_float(frames);
+            test_float_to_s16(frames);
+        }
+    }
+
+    printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
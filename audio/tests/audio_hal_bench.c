@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Prints the numbers to compare HAL changes by, on the fake backend of
+ * fake_tinyalsa.h, so that it also runs on the host:
+ *  - audio_route_init() time on the board mixer paths XML, parsing it and
+ *    loading the route cache,
+ *  - route switch latency, the audio_route_apply_paths() call the routing
+ *    thread makes, with instant ctls and with slow ones,
+ *  - CPU time of out_write() and in_read() per second of audio, with the
+ *    streams in direct and in decoupled mode.
+ * The CPU time is the one of the whole process, so that it includes the
+ * writer and capture threads of decoupled mode; nothing else runs.
+ *
+ * usage: audio_hal_bench [-s seconds of audio] [-i us per ctl ioctl]
+ */
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_route.h"
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define INIT_RUNS 20
+#define ROUTE_SWITCHES 200
+#define DEFAULT_SECONDS 2.0
+/* an I2C write of a codec register */
+#define DEFAULT_IOCTL_US 100
+
+struct stream_config {
+    const char *name;
+    uint32_t rate;
+    audio_channel_mask_t channels;
+    audio_output_flags_t flags;
+};
+
+static const struct stream_config out_configs[] = {
+    { "primary", 44100, AUDIO_CHANNEL_OUT_STEREO, AUDIO_OUTPUT_FLAG_PRIMARY },
+    { "fast", 44100, AUDIO_CHANNEL_OUT_STEREO, AUDIO_OUTPUT_FLAG_FAST },
+    { "primary 48k", 48000, AUDIO_CHANNEL_OUT_STEREO,
+      AUDIO_OUTPUT_FLAG_PRIMARY },
+};
+
+static const struct stream_config in_configs[] = {
+    { "48k stereo", 48000, AUDIO_CHANNEL_IN_STEREO, 0 },
+    { "48k mono", 48000, AUDIO_CHANNEL_IN_MONO, 0 },
+    { "16k mono", 16000, AUDIO_CHANNEL_IN_MONO, 0 },
+};
+
+static int64_t process_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void bench_init(bool cached)
+{
+    struct audio_route *ar;
+    int64_t start;
+    int64_t elapsed;
+    int64_t total_ns = 0;
+    int64_t max_ns = 0;
+    unsigned int run;
+
+    /* as the routing thread does once the HAL is up */
+    if (cached) {
+        ar = audio_route_init();
+        if (!TEST_CHECK(ar != NULL))
+            return;
+        TEST_CHECK(audio_route_save_cache(ar) == 0);
+        audio_route_free(ar);
+    }
+
+    for (run = 0; run < INIT_RUNS; run++) {
+        if (!cached)
+            unlink(MIXER_CACHE_PATH);
+        start = fake_now_ns();
+        ar = audio_route_init();
+        elapsed = fake_now_ns() - start;
+        if (!TEST_CHECK(ar != NULL))
+            return;
+        total_ns += elapsed;
+        if (elapsed > max_ns)
+            max_ns = elapsed;
+        audio_route_free(ar);
+    }
+
+    printf("audio_route_init() %-14s %8.3f ms mean %8.3f ms max\n",
+           cached ? "from cache" : "from XML",
+           total_ns / 1000000.0 / INIT_RUNS, max_ns / 1000000.0);
+}
+
+/* switches between speaker and headphone playback, with the mic on, like
+ * apply_route() does on a routing change */
+static void bench_route_switch(unsigned int ioctl_us)
+{
+    struct audio_route *ar = audio_route_init();
+    int paths[2][2];
+    unsigned int ioctls;
+    unsigned int i;
+    int64_t start;
+    int64_t elapsed;
+    int64_t total_ns = 0;
+    int64_t max_ns = 0;
+
+    if (!TEST_CHECK(ar != NULL))
+        return;
+    paths[0][0] = audio_route_get_path_handle(ar, "speaker");
+    paths[1][0] = audio_route_get_path_handle(ar, "headphone");
+    paths[0][1] = paths[1][1] = audio_route_get_path_handle(ar, "mic");
+    if (!TEST_CHECK(paths[0][0] >= 0 && paths[1][0] >= 0 &&
+                    paths[0][1] >= 0))
+        goto done;
+
+    fake_mixer_ioctl_us = ioctl_us;
+    fake_reset();
+    for (i = 0; i < ROUTE_SWITCHES; i++) {
+        start = fake_now_ns();
+        audio_route_apply_paths(ar, paths[i % 2], 2);
+        elapsed = fake_now_ns() - start;
+        total_ns += elapsed;
+        if (elapsed > max_ns)
+            max_ns = elapsed;
+    }
+    ioctls = fake_stats.mixer_ioctls;
+    fake_mixer_ioctl_us = 0;
+
+    printf("route switch %4u us/ioctl   %8.1f us mean %8.1f us max, "
+           "%.1f ioctls\n", ioctl_us, total_ns / 1000.0 / ROUTE_SWITCHES,
+           max_ns / 1000.0, (double)ioctls / ROUTE_SWITCHES);
+
+done:
+    audio_route_free(ar);
+}
+
+static void bench_out_write(struct audio_hw_device *dev,
+                            const struct stream_config *config,
+                            bool decoupled, double seconds)
+{
+    struct audio_stream_out *out;
+    int64_t start;
+    int64_t cpu_ns;
+    int64_t max_ns;
+
+    fake_property_set("audio.output.writer_thread", decoupled ? "1" : NULL);
+    fake_reset();
+    start = process_cpu_ns();
+    out = test_open_output(dev, config->flags, config->rate,
+                           config->channels);
+    max_ns = test_play(out, 1000, seconds);
+    dev->close_output_stream(dev, out);
+    cpu_ns = process_cpu_ns() - start;
+
+    printf("out_write() %-11s %-6s %6.2f ms CPU per s, "
+           "%6.2f ms max write, %u xruns\n", config->name,
+           decoupled ? "writer" : "direct", cpu_ns / 1000000.0 / seconds,
+           max_ns / 1000000.0, fake_stats.xruns);
+    TEST_CHECK(fake_stats.xruns == 0);
+}
+
+static void bench_in_read(struct audio_hw_device *dev,
+                          const struct stream_config *config,
+                          bool decoupled, double seconds)
+{
+    struct audio_stream_in *in;
+    size_t bytes;
+    size_t frames;
+    unsigned int count;
+    unsigned int i;
+    void *buffer;
+    int64_t start;
+    int64_t cpu_ns;
+
+    fake_property_set("audio.input.capture_thread", decoupled ? "1" : NULL);
+    fake_reset();
+    start = process_cpu_ns();
+    in = test_open_input(dev, AUDIO_DEVICE_IN_BUILTIN_MIC, config->rate,
+                         config->channels);
+    bytes = in->common.get_buffer_size(&in->common);
+    frames = bytes / audio_stream_frame_size(&in->common);
+    count = seconds * config->rate / frames + 1;
+    buffer = malloc(bytes);
+    for (i = 0; buffer && i < count; i++)
+        if (!TEST_CHECK(in->read(in, buffer, bytes) == (ssize_t)bytes))
+            break;
+    free(buffer);
+    dev->close_input_stream(dev, in);
+    cpu_ns = process_cpu_ns() - start;
+
+    printf("in_read()   %-11s %-6s %6.2f ms CPU per s, %u xruns\n",
+           config->name, decoupled ? "thread" : "direct",
+           cpu_ns / 1000000.0 / seconds, fake_stats.xruns);
+    TEST_CHECK(fake_stats.xruns == 0);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev;
+    double seconds = DEFAULT_SECONDS;
+    unsigned int ioctl_us = DEFAULT_IOCTL_US;
+    unsigned int i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:i:")) != -1) {
+        switch (opt) {
+        case 's':
+            seconds = atof(optarg);
+            break;
+        case 'i':
+            ioctl_us = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seconds] [-i ioctl_us]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (seconds <= 0) {
+        fprintf(stderr, "%s: seconds must be positive\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bench_init(false);
+    bench_init(true);
+    bench_route_switch(0);
+    bench_route_switch(ioctl_us);
+    unlink(MIXER_CACHE_PATH);
+
+    dev = test_open_device();
+    for (i = 0; i < sizeof(out_configs) / sizeof(out_configs[0]); i++) {
+        bench_out_write(dev, &out_configs[i], false, seconds);
+        bench_out_write(dev, &out_configs[i], true, seconds);
+    }
+    for (i = 0; i < sizeof(in_configs) / sizeof(in_configs[0]); i++) {
+        bench_in_read(dev, &in_configs[i], false, seconds);
+        bench_in_read(dev, &in_configs[i], true, seconds);
+    }
+    test_close_device(dev);
+    unlink(MIXER_CACHE_PATH);
+
+    return test_result();
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the output latency of the primary and the fast output profile,
+ * and checks how they share the single playback front-end. The latency
+ * measured is the most frames the PCM held behind a write, which is how
+ * long a sample written last waits before it plays. While one output holds
+ * the PCM the other one stays in standby, without trying to open the busy
+ * PCM, and takes it over once the first one stops.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <tinyalsa/asoundlib.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define PLAY_SECONDS 1.0
+#define PRIMARY_VALUE 1000
+#define FAST_VALUE 100
+/* the measured latency must be within 1/LATENCY_TOLERANCE of the reported
+ * one */
+#define LATENCY_TOLERANCE 4
+
+struct player {
+    struct audio_stream_out *out;
+    int16_t value;
+};
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int max_delay;
+static unsigned long samples;
+static unsigned long fast_samples;
+
+static void write_hook(unsigned int device, const int16_t *data,
+                       unsigned int frames, unsigned int channels)
+{
+    int delay = fake_pcm_get_delay(device);
+    unsigned int i;
+
+    pthread_mutex_lock(&stats_lock);
+    if (delay > (int)max_delay)
+        max_delay = delay;
+    for (i = 0; i < frames * channels; i++)
+        if (data[i] == FAST_VALUE)
+            fast_samples++;
+    samples += frames * channels;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+static void stats_reset(void)
+{
+    pthread_mutex_lock(&stats_lock);
+    max_delay = 0;
+    samples = 0;
+    fast_samples = 0;
+    pthread_mutex_unlock(&stats_lock);
+    fake_reset();
+}
+
+static uint32_t measured_latency_ms(void)
+{
+    return max_delay * 1000 / fake_pcm_get_rate(0, PCM_OUT);
+}
+
+/* plays out alone and returns the latency measured */
+static uint32_t test_alone(struct audio_stream_out *out, const char *name)
+{
+    uint32_t reported = out->get_latency(out);
+    uint32_t measured;
+
+    stats_reset();
+    test_play(out, PRIMARY_VALUE, PLAY_SECONDS);
+    measured = measured_latency_ms();
+    out->common.standby(&out->common);
+
+    printf("%-8s alone: reported %3u ms, measured %3u ms\n", name, reported,
+           measured);
+    /* pacing lets the PCM run a little above its threshold */
+    TEST_CHECK(measured >= reported - reported / LATENCY_TOLERANCE);
+    TEST_CHECK(measured <= reported + reported / LATENCY_TOLERANCE);
+    return measured;
+}
+
+static void *player_thread(void *context)
+{
+    struct player *player = (struct player *)context;
+
+    test_play(player->out, player->value, PLAY_SECONDS);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev = test_open_device();
+    struct audio_stream_out *primary;
+    struct audio_stream_out *fast;
+    struct player players[2];
+    pthread_t threads[2];
+    uint32_t primary_ms;
+    uint32_t fast_ms;
+    unsigned int i;
+
+    fake_pcm_write_hook = write_hook;
+    primary = test_open_output(dev, AUDIO_OUTPUT_FLAG_PRIMARY, 44100,
+                               AUDIO_CHANNEL_OUT_STEREO);
+    fast = test_open_output(dev, AUDIO_OUTPUT_FLAG_FAST, 44100,
+                            AUDIO_CHANNEL_OUT_STEREO);
+
+    primary_ms = test_alone(primary, "primary");
+    fast_ms = test_alone(fast, "fast");
+    TEST_CHECK(fast_ms < primary_ms);
+    TEST_CHECK(fast->get_latency(fast) < primary->get_latency(primary));
+
+    /* the primary output starts first and keeps the PCM */
+    stats_reset();
+    players[0].out = primary;
+    players[0].value = PRIMARY_VALUE;
+    players[1].out = fast;
+    players[1].value = FAST_VALUE;
+    pthread_create(&threads[0], NULL, player_thread, &players[0]);
+    usleep(50000);
+    pthread_create(&threads[1], NULL, player_thread, &players[1]);
+    for (i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    printf("both: %u busy opens, %lu of %lu samples from the fast output\n",
+           fake_stats.pcm_busy_opens, fast_samples, samples);
+    TEST_CHECK(fake_stats.pcm_busy_opens == 0);
+    TEST_CHECK(fast_samples == 0);
+    TEST_CHECK(samples > 0);
+
+    /* the fast output takes the PCM over once the primary one stops */
+    primary->common.standby(&primary->common);
+    stats_reset();
+    test_play(fast, FAST_VALUE, PLAY_SECONDS / 4);
+    printf("fast after primary: %lu samples\n", fast_samples);
+    TEST_CHECK(fake_stats.pcm_busy_opens == 0);
+    TEST_CHECK(fast_samples > 0);
+
+    dev->close_output_stream(dev, fast);
+    dev->close_output_stream(dev, primary);
+    test_close_device(dev);
+
+    return test_result();
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Plays and captures a ramp through the mmap transport, for several times
+ * the PCM buffer so that the DMA ring wraps around, and checks that no
+ * frame is lost, repeated or reordered. Each stream is then starved for
+ * longer than its buffer: the xrun must be reported and the stream must
+ * carry on, the ramp being continuous again from the first frame after it.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+/* many times the largest PCM buffer, about 150 ms */
+#define RAMP_SECONDS 2.0
+#define STARVE_US 300000
+
+static pthread_mutex_t ramp_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool ramp_started;
+static int16_t ramp_next;
+static unsigned long ramp_frames;
+static unsigned int ramp_breaks;
+
+static void ramp_reset(void)
+{
+    pthread_mutex_lock(&ramp_lock);
+    ramp_started = false;
+    ramp_frames = 0;
+    ramp_breaks = 0;
+    pthread_mutex_unlock(&ramp_lock);
+}
+
+/* checks that frames continue the ramp, all channels of a frame being
+ * equal. Silence does not count, as the PCM plays it before a start. */
+static void ramp_check(const int16_t *data, unsigned int frames,
+                       unsigned int channels)
+{
+    unsigned int i;
+    unsigned int j;
+
+    pthread_mutex_lock(&ramp_lock);
+    for (i = 0; i < frames; i++) {
+        const int16_t *frame = data + i * channels;
+
+        for (j = 1; j < channels; j++)
+            if (frame[j] != frame[0])
+                ramp_breaks++;
+        if (ramp_started && frame[0] != ramp_next)
+            ramp_breaks++;
+        ramp_started = true;
+        ramp_next = frame[0] + 1;
+        ramp_frames++;
+    }
+    pthread_mutex_unlock(&ramp_lock);
+}
+
+static void write_hook(unsigned int device, const int16_t *data,
+                       unsigned int frames, unsigned int channels)
+{
+    ramp_check(data, frames, channels);
+}
+
+/* writes count buffers of the ramp, starting at *value */
+static void play_ramp(struct audio_stream_out *out, int16_t *value,
+                      unsigned int count)
+{
+    size_t bytes = out->common.get_buffer_size(&out->common);
+    size_t frames = bytes / audio_stream_frame_size(&out->common);
+    int16_t *buffer = malloc(bytes);
+    unsigned int i;
+    size_t j;
+
+    for (i = 0; buffer && i < count; i++) {
+        for (j = 0; j < frames; j++) {
+            buffer[j * 2] = *value;
+            buffer[j * 2 + 1] = *value;
+            (*value)++;
+        }
+        TEST_CHECK(out->write(out, buffer, bytes) == (ssize_t)bytes);
+    }
+    free(buffer);
+}
+
+static void read_ramp(struct audio_stream_in *in, unsigned int count)
+{
+    size_t bytes = in->common.get_buffer_size(&in->common);
+    size_t frames = bytes / audio_stream_frame_size(&in->common);
+    int16_t *buffer = malloc(bytes);
+    unsigned int i;
+
+    for (i = 0; buffer && i < count; i++) {
+        if (!TEST_CHECK(in->read(in, buffer, bytes) == (ssize_t)bytes))
+            break;
+        ramp_check(buffer, frames, 1);
+    }
+    free(buffer);
+}
+
+static unsigned int stream_xruns(struct audio_stream *stream)
+{
+    char *reply = stream->get_parameters(stream, "stats");
+    char *value = reply ? strstr(reply, "stats_xruns=") : NULL;
+    unsigned int xruns = value ? atoi(value + strlen("stats_xruns=")) : 0;
+
+    free(reply);
+    return xruns;
+}
+
+static void test_output(struct audio_hw_device *dev)
+{
+    struct audio_stream_out *out;
+    size_t frames;
+    unsigned int count;
+    int16_t value = 0;
+    size_t bytes;
+    void *silence;
+
+    out = test_open_output(dev, AUDIO_OUTPUT_FLAG_PRIMARY, 44100,
+                           AUDIO_CHANNEL_OUT_STEREO);
+    bytes = out->common.get_buffer_size(&out->common);
+    frames = bytes / audio_stream_frame_size(&out->common);
+    count = RAMP_SECONDS * 44100 / frames;
+
+    fake_reset();
+    ramp_reset();
+    fake_pcm_write_hook = write_hook;
+    play_ramp(out, &value, count);
+    printf("output: %lu frames played, %u ramp breaks, %u pcm_write() "
+           "calls\n", ramp_frames, ramp_breaks, fake_stats.pcm_writes);
+    TEST_CHECK(ramp_frames >= count * frames);
+    TEST_CHECK(ramp_breaks == 0);
+    TEST_CHECK(fake_stats.pcm_writes == 0);
+
+    /* the first write after the underrun reports it, the ramp goes on
+     * from the frames of the next one */
+    usleep(STARVE_US);
+    silence = calloc(1, bytes);
+    if (silence)
+        out->write(out, silence, bytes);
+    free(silence);
+    ramp_reset();
+    play_ramp(out, &value, count / 4);
+    printf("output underrun: %u xruns, %u reported, %u ramp breaks\n",
+           fake_stats.xruns, stream_xruns(&out->common), ramp_breaks);
+    TEST_CHECK(fake_stats.xruns >= 1);
+    TEST_CHECK(stream_xruns(&out->common) >= 1);
+    TEST_CHECK(ramp_breaks == 0);
+
+    fake_pcm_write_hook = NULL;
+    dev->close_output_stream(dev, out);
+}
+
+static void test_input(struct audio_hw_device *dev)
+{
+    struct audio_stream_in *in;
+    size_t frames;
+    unsigned int count;
+
+    in = test_open_input(dev, AUDIO_DEVICE_IN_BUILTIN_MIC, 44100,
+                         AUDIO_CHANNEL_IN_MONO);
+    frames = in->common.get_buffer_size(&in->common) /
+            audio_stream_frame_size(&in->common);
+    count = RAMP_SECONDS * 44100 / frames;
+
+    fake_reset();
+    ramp_reset();
+    read_ramp(in, count);
+    printf("input: %lu frames captured, %u ramp breaks, %u pcm_read() "
+           "calls\n", ramp_frames, ramp_breaks, fake_stats.pcm_reads);
+    TEST_CHECK(ramp_frames == count * frames);
+    TEST_CHECK(ramp_breaks == 0);
+    TEST_CHECK(fake_stats.pcm_reads == 0);
+
+    /* the ramp restarts from where the PCM was started again */
+    usleep(STARVE_US);
+    read_ramp(in, 1);
+    ramp_reset();
+    read_ramp(in, count / 4);
+    printf("input overrun: %u xruns, %u reported, %u ramp breaks\n",
+           fake_stats.xruns, stream_xruns(&in->common), ramp_breaks);
+    TEST_CHECK(fake_stats.xruns >= 1);
+    TEST_CHECK(stream_xruns(&in->common) >= 1);
+    TEST_CHECK(ramp_breaks == 0);
+
+    dev->close_input_stream(dev, in);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev;
+
+    fake_property_set("audio.mmap.output", "1");
+    fake_property_set("audio.mmap.input", "1");
+    dev = test_open_device();
+
+    test_output(dev);
+    test_input(dev);
+
+    test_close_device(dev);
+
+    return test_result();
+}
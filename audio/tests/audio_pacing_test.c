@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Reports how often out_write() wakes up and how late its pacing sleeps
+ * return, for the primary output with the screen on and off and for the
+ * fast output. Pacing sleeps once per write at most, on an absolute
+ * deadline, and the output must not underrun.
+ */
+
+#include <stdio.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define PLAY_SECONDS 2.0
+/* mean lateness of the pacing sleeps allowed */
+#define MAX_MEAN_LATE_US 2000
+
+static void test_pacing(struct audio_hw_device *dev, const char *name,
+                        audio_output_flags_t flags, bool screen_off)
+{
+    struct audio_stream_out *out;
+    size_t frame_size;
+    unsigned int writes;
+    double mean_late_us;
+
+    dev->set_parameters(dev, screen_off ? "screen_state=off" :
+                        "screen_state=on");
+    out = test_open_output(dev, flags, 44100, AUDIO_CHANNEL_OUT_STEREO);
+    frame_size = audio_stream_frame_size(&out->common);
+
+    /* let the write threshold settle first */
+    test_play(out, 1000, 0.5);
+    fake_reset();
+    test_play(out, 1000, PLAY_SECONDS);
+    writes = fake_stats.pcm_writes;
+    mean_late_us = fake_stats.sleeps ?
+            fake_stats.sleep_late_ns / 1000.0 / fake_stats.sleeps : 0.0;
+
+    printf("%-18s %5zu frame writes: %6.1f writes/s, %6.1f sleeps/s, "
+           "late %6.1f/%6.1f us mean/max, %u xruns\n", name,
+           out->common.get_buffer_size(&out->common) / frame_size,
+           writes / PLAY_SECONDS, fake_stats.sleeps / PLAY_SECONDS,
+           mean_late_us, fake_stats.sleep_max_late_ns / 1000.0,
+           fake_stats.xruns);
+    TEST_CHECK(writes > 0);
+    TEST_CHECK(fake_stats.sleeps <= writes);
+    TEST_CHECK(mean_late_us < MAX_MEAN_LATE_US);
+    TEST_CHECK(fake_stats.xruns == 0);
+
+    dev->close_output_stream(dev, out);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev = test_open_device();
+
+    test_pacing(dev, "primary screen on", AUDIO_OUTPUT_FLAG_PRIMARY, false);
+    test_pacing(dev, "primary screen off", AUDIO_OUTPUT_FLAG_PRIMARY, true);
+    test_pacing(dev, "fast", AUDIO_OUTPUT_FLAG_FAST, false);
+
+    test_close_device(dev);
+
+    return test_result();
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs playback and capture together at every pair of rates that
+ * audio_policy.conf lists, starting either one first. The stream started
+ * second must join the rate group of the PCM already open, and resample if
+ * needed, rather than put the other stream in standby. Playback started
+ * alone keeps its native 44.1 kHz PCM.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <tinyalsa/asoundlib.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define PCM_DEVICE 0
+#define PLAY_SECONDS 0.6
+/* time the first stream runs alone, then both run */
+#define ALONE_US 150000
+#define CAPTURE_SECONDS 0.3
+
+static const uint32_t out_rates[] = { 44100 };
+static const uint32_t in_rates[] = {
+    8000, 11025, 16000, 22050, 32000, 44100, 48000
+};
+
+struct capture {
+    struct audio_stream_in *in;
+    double seconds;
+    unsigned int failed_reads;
+};
+
+static void *play_thread(void *context)
+{
+    test_play((struct audio_stream_out *)context, 1000, PLAY_SECONDS);
+    return NULL;
+}
+
+static void *capture_thread(void *context)
+{
+    struct capture *capture = (struct capture *)context;
+    struct audio_stream_in *in = capture->in;
+    size_t bytes = in->common.get_buffer_size(&in->common);
+    size_t frames = bytes / audio_stream_frame_size(&in->common);
+    unsigned int count = capture->seconds *
+            in->common.get_sample_rate(&in->common) / frames + 1;
+    void *buffer = malloc(bytes);
+    unsigned int i;
+
+    for (i = 0; buffer && i < count; i++)
+        if (in->read(in, buffer, bytes) != (ssize_t)bytes)
+            capture->failed_reads++;
+    free(buffer);
+    return NULL;
+}
+
+static bool rates_share_group(uint32_t a, uint32_t b)
+{
+    return (a % 11025 == 0) == (b % 11025 == 0);
+}
+
+static void test_rates(struct audio_hw_device *dev, uint32_t out_rate,
+                       uint32_t in_rate, bool out_first)
+{
+    struct audio_stream_out *out;
+    struct capture capture;
+    pthread_t first;
+    pthread_t second;
+    unsigned int opens;
+    uint32_t out_pcm_rate;
+    uint32_t in_pcm_rate;
+
+    out = test_open_output(dev, AUDIO_OUTPUT_FLAG_PRIMARY, out_rate,
+                           AUDIO_CHANNEL_OUT_STEREO);
+    capture.in = test_open_input(dev, AUDIO_DEVICE_IN_BUILTIN_MIC, in_rate,
+                                 AUDIO_CHANNEL_IN_MONO);
+    capture.failed_reads = 0;
+    fake_reset();
+
+    /* the first stream runs the whole time, the second one starts later */
+    if (out_first) {
+        capture.seconds = CAPTURE_SECONDS;
+        pthread_create(&first, NULL, play_thread, out);
+        usleep(ALONE_US);
+        TEST_CHECK(fake_pcm_get_rate(PCM_DEVICE, PCM_OUT) == out_rate);
+        pthread_create(&second, NULL, capture_thread, &capture);
+    } else {
+        capture.seconds = PLAY_SECONDS;
+        pthread_create(&first, NULL, capture_thread, &capture);
+        usleep(ALONE_US);
+        pthread_create(&second, NULL, play_thread, out);
+    }
+    usleep(ALONE_US);
+    out_pcm_rate = fake_pcm_get_rate(PCM_DEVICE, PCM_OUT);
+    in_pcm_rate = fake_pcm_get_rate(PCM_DEVICE, PCM_IN);
+    pthread_join(second, NULL);
+    pthread_join(first, NULL);
+    opens = fake_stats.pcm_opens;
+
+    printf("out %5u Hz, in %5u Hz, %s first: PCMs at %5u/%5u Hz, "
+           "%u opens, %u xruns\n", out_rate, in_rate,
+           out_first ? "out" : " in", out_pcm_rate, in_pcm_rate, opens,
+           fake_stats.xruns);
+    TEST_CHECK(out_pcm_rate != 0 && in_pcm_rate != 0);
+    TEST_CHECK(rates_share_group(out_pcm_rate, in_pcm_rate));
+    /* neither stream went to standby and reopened its PCM */
+    TEST_CHECK(opens == 2);
+    TEST_CHECK(fake_stats.xruns == 0);
+    TEST_CHECK(capture.failed_reads == 0);
+
+    dev->close_input_stream(dev, capture.in);
+    dev->close_output_stream(dev, out);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev = test_open_device();
+    unsigned int i;
+    unsigned int j;
+
+    for (i = 0; i < sizeof(out_rates) / sizeof(out_rates[0]); i++) {
+        for (j = 0; j < sizeof(in_rates) / sizeof(in_rates[0]); j++) {
+            test_rates(dev, out_rates[i], in_rates[j], true);
+            test_rates(dev, out_rates[i], in_rates[j], false);
+        }
+    }
+
+    test_close_device(dev);
+
+    return test_result();
+}
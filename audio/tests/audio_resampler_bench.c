@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the CPU time one second of audio takes through the resampling
+ * paths of out_write() and read_frames(), for each resampler quality set
+ * with the resampler_quality stream parameter. Capture runs at 16 kHz from
+ * a 48 kHz PCM. Playback runs at 44.1 kHz into a PCM that a 48 kHz capture
+ * started first holds in the 48 kHz group.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define RUN_SECONDS 1.0
+
+static const char *qualities[] = { "low", "default", "high", "voip" };
+
+struct capture {
+    struct audio_stream_in *in;
+    volatile bool stop;
+    double seconds; /* 0 to read until stop */
+    int64_t cpu_ns;
+};
+
+static int64_t thread_cpu_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* the frames the stream resampled, from its stats */
+static long long resampled_frames(struct audio_stream *stream)
+{
+    char *reply = stream->get_parameters(stream, "stats");
+    char *value = reply ? strstr(reply, "stats_resampled_frames=") : NULL;
+    long long frames = value ?
+            atoll(value + strlen("stats_resampled_frames=")) : 0;
+
+    free(reply);
+    return frames;
+}
+
+static bool set_quality(struct audio_stream *stream, const char *quality)
+{
+    char kvpairs[64];
+    char *reply;
+    bool ok;
+
+    snprintf(kvpairs, sizeof(kvpairs), "resampler_quality=%s", quality);
+    if (stream->set_parameters(stream, kvpairs) != 0)
+        return false;
+    reply = stream->get_parameters(stream, "resampler_quality");
+    ok = reply && strcmp(reply, kvpairs) == 0;
+    free(reply);
+    return ok;
+}
+
+static void *capture_thread(void *context)
+{
+    struct capture *capture = (struct capture *)context;
+    struct audio_stream_in *in = capture->in;
+    size_t bytes = in->common.get_buffer_size(&in->common);
+    size_t frames = bytes / audio_stream_frame_size(&in->common);
+    unsigned int count = capture->seconds *
+            in->common.get_sample_rate(&in->common) / frames + 1;
+    void *buffer = malloc(bytes);
+    int64_t start = thread_cpu_ns();
+    unsigned int i;
+
+    for (i = 0; buffer && !capture->stop &&
+            (!capture->seconds || i < count); i++)
+        if (!TEST_CHECK(in->read(in, buffer, bytes) == (ssize_t)bytes))
+            break;
+    capture->cpu_ns = thread_cpu_ns() - start;
+    free(buffer);
+    return NULL;
+}
+
+static void bench_capture(struct audio_hw_device *dev, const char *quality)
+{
+    struct capture capture;
+    pthread_t thread;
+
+    capture.in = test_open_input(dev, AUDIO_DEVICE_IN_BUILTIN_MIC, 16000,
+                                 AUDIO_CHANNEL_IN_MONO);
+    capture.stop = false;
+    capture.seconds = RUN_SECONDS;
+    TEST_CHECK(set_quality(&capture.in->common, quality));
+    pthread_create(&thread, NULL, capture_thread, &capture);
+    pthread_join(thread, NULL);
+
+    printf("in_read()   %-8s %6.2f ms CPU per second of audio\n", quality,
+           capture.cpu_ns / 1000000.0 / RUN_SECONDS);
+    TEST_CHECK(resampled_frames(&capture.in->common) > 0);
+    dev->close_input_stream(dev, capture.in);
+}
+
+static void bench_playback(struct audio_hw_device *dev, const char *quality)
+{
+    struct audio_stream_out *out;
+    struct capture capture;
+    pthread_t thread;
+    int64_t start;
+    int64_t cpu_ns;
+
+    /* the capture opens the PCMs in the 48 kHz group */
+    capture.in = test_open_input(dev, AUDIO_DEVICE_IN_BUILTIN_MIC, 48000,
+                                 AUDIO_CHANNEL_IN_MONO);
+    capture.stop = false;
+    capture.seconds = 0;
+    pthread_create(&thread, NULL, capture_thread, &capture);
+    usleep(50000);
+
+    out = test_open_output(dev, AUDIO_OUTPUT_FLAG_PRIMARY, 44100,
+                           AUDIO_CHANNEL_OUT_STEREO);
+    TEST_CHECK(set_quality(&out->common, quality));
+    start = thread_cpu_ns();
+    test_play(out, 1000, RUN_SECONDS);
+    cpu_ns = thread_cpu_ns() - start;
+    capture.stop = true;
+    pthread_join(thread, NULL);
+
+    printf("out_write() %-8s %6.2f ms CPU per second of audio\n", quality,
+           cpu_ns / 1000000.0 / RUN_SECONDS);
+    TEST_CHECK(resampled_frames(&out->common) > 0);
+    dev->close_output_stream(dev, out);
+    dev->close_input_stream(dev, capture.in);
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev = test_open_device();
+    unsigned int i;
+
+    for (i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++)
+        bench_capture(dev, qualities[i]);
+    for (i = 0; i < sizeof(qualities) / sizeof(qualities[0]); i++)
+        bench_playback(dev, qualities[i]);
+
+    test_close_device(dev);
+
+    return test_result();
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times path application against a synthetic mixer with thousands of ctls.
+ * The paths of a generated XML are applied with the mixer holding only the
+ * ctls of the XML, then with many more ctls ahead of them. Applying a path
+ * looks its ctls up by index, so its cost must not grow with the mixer.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "audio_route.h"
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define NUM_CTLS 2048
+#define NUM_PATHS 16
+#define SETTINGS_PER_PATH 128
+#define EXTRA_CTLS 16384
+#define ITERATIONS 20000
+/* the largest mixer may make applying a path this much slower */
+#define MAX_SLOWDOWN 3
+
+static bool write_xml(void)
+{
+    FILE *file = fopen(MIXER_XML_PATH, "w");
+    unsigned int path;
+    unsigned int i;
+
+    if (!file)
+        return false;
+    fprintf(file, "<mixer>\n");
+    for (i = 0; i < NUM_CTLS; i++)
+        fprintf(file, "  <ctl name=\"Bench ctl %u\" value=\"0\" />\n", i);
+    for (path = 0; path < NUM_PATHS; path++) {
+        fprintf(file, "  <path name=\"path%u\">\n", path);
+        for (i = 0; i < SETTINGS_PER_PATH; i++)
+            fprintf(file, "    <ctl name=\"Bench ctl %u\" value=\"1\" />\n",
+                    (path * SETTINGS_PER_PATH + i) % NUM_CTLS);
+        fprintf(file, "  </path>\n");
+    }
+    fprintf(file, "</mixer>\n");
+    return fclose(file) == 0;
+}
+
+/* returns the ns one path setting takes to apply */
+static double bench_apply(unsigned int extra_ctls)
+{
+    struct audio_route *ar;
+    int handles[NUM_PATHS];
+    char name[16];
+    int64_t start;
+    int64_t elapsed;
+    unsigned int i;
+
+    fake_mixer_extra_ctls = extra_ctls;
+    ar = audio_route_init();
+    if (!TEST_CHECK(ar != NULL))
+        return 0;
+    for (i = 0; i < NUM_PATHS; i++) {
+        snprintf(name, sizeof(name), "path%u", i);
+        handles[i] = audio_route_get_path_handle(ar, name);
+        TEST_CHECK(handles[i] >= 0);
+    }
+
+    start = fake_now_ns();
+    for (i = 0; i < ITERATIONS; i++) {
+        reset_mixer_state(ar);
+        audio_route_apply_path_handle(ar, handles[i % NUM_PATHS]);
+    }
+    elapsed = fake_now_ns() - start;
+    audio_route_free(ar);
+
+    printf("%5u ctls: %.1f ns per setting applied\n", NUM_CTLS + extra_ctls,
+           (double)elapsed / ITERATIONS / SETTINGS_PER_PATH);
+    return (double)elapsed / ITERATIONS / SETTINGS_PER_PATH;
+}
+
+int main(int argc, char **argv)
+{
+    double small_ns;
+    double large_ns;
+
+    if (!TEST_CHECK(write_xml()))
+        return test_result();
+
+    small_ns = bench_apply(0);
+    large_ns = bench_apply(EXTRA_CTLS);
+    TEST_CHECK(large_ns < small_ns * MAX_SLOWDOWN);
+
+    unlink(MIXER_XML_PATH);
+    return test_result();
+}
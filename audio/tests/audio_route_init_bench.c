@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Times a cold audio_route_init() on a generated mixer paths XML, once
+ * parsing the XML and once loading the compiled route cache written by
+ * audio_route_save_cache() afterwards, which init itself must not write.
+ * Both must give the same paths: applying each of them must write the same
+ * number of ctls.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "audio_route.h"
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define NUM_CTLS 2048
+#define NUM_PATHS 256
+#define SETTINGS_PER_PATH 32
+#define RUNS 10
+
+static bool write_xml(void)
+{
+    FILE *file = fopen(MIXER_XML_PATH, "w");
+    unsigned int path;
+    unsigned int i;
+
+    if (!file)
+        return false;
+    fprintf(file, "<mixer>\n");
+    for (i = 0; i < NUM_CTLS; i++)
+        fprintf(file, "  <ctl name=\"Bench ctl %u\" value=\"0\" />\n", i);
+    for (path = 0; path < NUM_PATHS; path++) {
+        fprintf(file, "  <path name=\"path%u\">\n", path);
+        for (i = 0; i < SETTINGS_PER_PATH; i++)
+            fprintf(file, "    <ctl name=\"Bench ctl %u\" value=\"%u\" />\n",
+                    (path * 7 + i * 13) % NUM_CTLS, path % 3 + 1);
+        fprintf(file, "  </path>\n");
+    }
+    fprintf(file, "</mixer>\n");
+    return fclose(file) == 0;
+}
+
+/* times RUNS inits, without the cache if cached is false, and returns the
+ * mean in ms. ioctls gets the ctl writes of applying each path. */
+static double bench_init(bool cached, unsigned int *ioctls)
+{
+    struct audio_route *ar;
+    char name[16];
+    int64_t start;
+    int64_t elapsed = 0;
+    unsigned int before;
+    unsigned int run;
+    unsigned int i;
+    int handle;
+
+    for (run = 0; run < RUNS; run++) {
+        if (!cached)
+            unlink(MIXER_CACHE_PATH);
+        start = fake_now_ns();
+        ar = audio_route_init();
+        elapsed += fake_now_ns() - start;
+        if (!TEST_CHECK(ar != NULL))
+            return 0;
+        /* the routing thread writes the cache after init */
+        TEST_CHECK(audio_route_save_cache(ar) == 0);
+        if (run < RUNS - 1) {
+            audio_route_free(ar);
+            continue;
+        }
+
+        for (i = 0; i < NUM_PATHS; i++) {
+            snprintf(name, sizeof(name), "path%u", i);
+            handle = audio_route_get_path_handle(ar, name);
+            if (!TEST_CHECK(handle >= 0))
+                break;
+            before = fake_stats.mixer_ioctls;
+            reset_mixer_state(ar);
+            audio_route_apply_path_handle(ar, handle);
+            update_mixer_state(ar);
+            ioctls[i] = fake_stats.mixer_ioctls - before;
+        }
+        audio_route_free(ar);
+    }
+
+    printf("init %-12s %7.2f ms\n", cached ? "from cache:" : "from XML:",
+           elapsed / 1000000.0 / RUNS);
+    return elapsed / 1000000.0 / RUNS;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int xml_ioctls[NUM_PATHS];
+    unsigned int cache_ioctls[NUM_PATHS];
+    double xml_ms;
+    double cache_ms;
+    struct audio_route *ar;
+    unsigned int i;
+
+    if (!TEST_CHECK(write_xml()))
+        return test_result();
+
+    unlink(MIXER_CACHE_PATH);
+    ar = audio_route_init();
+    TEST_CHECK(ar != NULL);
+    TEST_CHECK(access(MIXER_CACHE_PATH, F_OK) < 0);
+    audio_route_free(ar);
+
+    xml_ms = bench_init(false, xml_ioctls);
+    TEST_CHECK(access(MIXER_CACHE_PATH, R_OK) == 0);
+    cache_ms = bench_init(true, cache_ioctls);
+    TEST_CHECK(cache_ms < xml_ms);
+    for (i = 0; i < NUM_PATHS; i++)
+        if (!TEST_CHECK(xml_ioctls[i] == cache_ioctls[i]))
+            break;
+
+    unlink(MIXER_CACHE_PATH);
+    unlink(MIXER_XML_PATH);
+    return test_result();
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Plays the primary output while another thread keeps switching its route
+ * and the orientation, on a mixer whose every ioctl is slow. The routing
+ * thread commits the switches, so neither the parameter calls nor the
+ * writes may wait for the mixer, and the output must not underrun.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+#define PLAY_SECONDS 2.0
+#define IOCTL_US 2000
+/* a write may block for its own buffer, plus this much */
+#define MAX_WRITE_SLACK_MS 10
+#define MAX_SET_PARAMETERS_MS 5
+
+struct storm {
+    struct audio_hw_device *dev;
+    struct audio_stream_out *out;
+    volatile bool stop;
+    unsigned int switches;
+    int64_t max_ns;
+};
+
+static void *storm_thread(void *context)
+{
+    struct storm *storm = (struct storm *)context;
+    struct audio_stream_out *out = storm->out;
+    int64_t start;
+    int64_t elapsed;
+
+    while (!storm->stop) {
+        start = fake_now_ns();
+        out->common.set_parameters(&out->common, (storm->switches & 1) ?
+                                   "routing=8" : "routing=2");
+        storm->dev->set_parameters(storm->dev, (storm->switches & 2) ?
+                                   "orientation=landscape" :
+                                   "orientation=portrait");
+        elapsed = fake_now_ns() - start;
+        if (elapsed > storm->max_ns)
+            storm->max_ns = elapsed;
+        storm->switches++;
+        usleep(1000);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_hw_device *dev = test_open_device();
+    struct audio_stream_out *out;
+    struct storm storm;
+    pthread_t thread;
+    uint32_t buffer_ms;
+    int64_t max_write_ns;
+    unsigned int ioctls;
+
+    out = test_open_output(dev, AUDIO_OUTPUT_FLAG_PRIMARY, 44100,
+                           AUDIO_CHANNEL_OUT_STEREO);
+    buffer_ms = out->common.get_buffer_size(&out->common) * 1000 /
+            audio_stream_frame_size(&out->common) / 44100;
+
+    /* start playing before the storm, with a fast mixer */
+    test_play(out, 1000, 0.2);
+    fake_mixer_ioctl_us = IOCTL_US;
+    fake_reset();
+
+    storm.dev = dev;
+    storm.out = out;
+    storm.stop = false;
+    storm.switches = 0;
+    storm.max_ns = 0;
+    pthread_create(&thread, NULL, storm_thread, &storm);
+    max_write_ns = test_play(out, 1000, PLAY_SECONDS);
+    storm.stop = true;
+    pthread_join(thread, NULL);
+    ioctls = fake_stats.mixer_ioctls;
+
+    printf("%u route switches, %u mixer ioctls of %u us\n", storm.switches,
+           ioctls, IOCTL_US);
+    printf("max set_parameters %.1f ms, max write %.1f ms for a %u ms "
+           "buffer, %u xruns\n", storm.max_ns / 1000000.0,
+           max_write_ns / 1000000.0, buffer_ms, fake_stats.xruns);
+    TEST_CHECK(ioctls > 0);
+    TEST_CHECK(storm.max_ns < MAX_SET_PARAMETERS_MS * 1000000LL);
+    TEST_CHECK(max_write_ns < (buffer_ms + MAX_WRITE_SLACK_MS) * 1000000LL);
+    TEST_CHECK(fake_stats.xruns == 0);
+
+    fake_mixer_ioctl_us = 0;
+    dev->close_output_stream(dev, out);
+    test_close_device(dev);
+
+    return test_result();
+}
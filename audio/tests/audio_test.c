@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_test.h"
+
+static unsigned int test_failures;
+
+bool test_check(bool cond, const char *text, const char *file, int line)
+{
+    if (!cond) {
+        printf("FAIL %s:%d: %s\n", file, line, text);
+        test_failures++;
+    }
+    return cond;
+}
+
+int test_result(void)
+{
+    printf("%s\n", test_failures ? "FAILED" : "PASSED");
+    return test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AUDIO_TEST_H
+#define AUDIO_TEST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <hardware/audio.h>
+
+/* Helpers shared by the tests. Those below the checks, in audio_test_hal.c,
+   drive the HAL like AudioFlinger would, linked against the fakes of
+   fake_tinyalsa.h. */
+
+#define TEST_CHECK(cond) test_check(cond, #cond, __FILE__, __LINE__)
+
+/* counts and prints a failed check, returns cond */
+bool test_check(bool cond, const char *text, const char *file, int line);
+/* EXIT_SUCCESS if no check failed so far */
+int test_result(void);
+
+/* audio_test_hal.c */
+
+/* opens the HAL the tests are linked with */
+struct audio_hw_device *test_open_device(void);
+void test_close_device(struct audio_hw_device *dev);
+
+/* opens a 16 bit output with flags, at rate and with channels */
+struct audio_stream_out *test_open_output(struct audio_hw_device *dev,
+                                          audio_output_flags_t flags,
+                                          uint32_t rate,
+                                          audio_channel_mask_t channels);
+struct audio_stream_in *test_open_input(struct audio_hw_device *dev,
+                                        audio_devices_t device,
+                                        uint32_t rate,
+                                        audio_channel_mask_t channels);
+
+/* writes seconds of samples, all set to value, a buffer at a time, and
+   returns the longest write() call in ns */
+int64_t test_play(struct audio_stream_out *out, int16_t value, double seconds);
+
+#endif
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "audio_test.h"
+#include "fake_tinyalsa.h"
+
+extern struct audio_module HAL_MODULE_INFO_SYM;
+
+struct audio_hw_device *test_open_device(void)
+{
+    struct hw_device_t *device;
+
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+            AUDIO_HARDWARE_INTERFACE, &device) != 0) {
+        printf("FAIL: cannot open the audio HAL\n");
+        exit(EXIT_FAILURE);
+    }
+    return (struct audio_hw_device *)device;
+}
+
+void test_close_device(struct audio_hw_device *dev)
+{
+    dev->common.close(&dev->common);
+}
+
+struct audio_stream_out *test_open_output(struct audio_hw_device *dev,
+                                          audio_output_flags_t flags,
+                                          uint32_t rate,
+                                          audio_channel_mask_t channels)
+{
+    struct audio_config config = {
+        .sample_rate = rate,
+        .channel_mask = channels,
+        .format = AUDIO_FORMAT_PCM_16_BIT,
+    };
+    struct audio_stream_out *out;
+
+    if (!TEST_CHECK(dev->open_output_stream(dev, 0, AUDIO_DEVICE_OUT_SPEAKER,
+                                            flags, &config, &out) == 0))
+        exit(test_result());
+    return out;
+}
+
+struct audio_stream_in *test_open_input(struct audio_hw_device *dev,
+                                        audio_devices_t device,
+                                        uint32_t rate,
+                                        audio_channel_mask_t channels)
+{
+    struct audio_config config = {
+        .sample_rate = rate,
+        .channel_mask = channels,
+        .format = AUDIO_FORMAT_PCM_16_BIT,
+    };
+    struct audio_stream_in *in;
+
+    if (!TEST_CHECK(dev->open_input_stream(dev, 0, device, &config,
+                                           &in) == 0))
+        exit(test_result());
+    return in;
+}
+
+int64_t test_play(struct audio_stream_out *out, int16_t value, double seconds)
+{
+    size_t bytes = out->common.get_buffer_size(&out->common);
+    size_t frame_size = audio_stream_frame_size(&out->common);
+    uint32_t rate = out->common.get_sample_rate(&out->common);
+    size_t frames = bytes / frame_size;
+    unsigned int count = seconds * rate / frames + 1;
+    int16_t *buffer = malloc(bytes);
+    int64_t max_ns = 0;
+    int64_t start;
+    unsigned int i;
+
+    if (!buffer)
+        return -1;
+    for (i = 0; i < bytes / sizeof(int16_t); i++)
+        buffer[i] = value;
+    for (i = 0; i < count; i++) {
+        start = fake_now_ns();
+        if (!TEST_CHECK(out->write(out, buffer, bytes) == (ssize_t)bytes))
+            break;
+        if (fake_now_ns() - start > max_ns)
+            max_ns = fake_now_ns() - start;
+    }
+    free(buffer);
+    return max_ns;
+}
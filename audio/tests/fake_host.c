@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Stand-ins for what the HAL takes from bionic and libaudioutils, for the
+ * host build of the tests: glibc has no gettid(), and libaudioutils, built
+ * on the speex resampler, has no host build. The resampler here picks the
+ * nearest input frame, so it keeps rates and frame counts right but costs
+ * far less CPU than the real one; host numbers of resampled streams only
+ * show what the HAL adds around it.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <audio_utils/resampler.h>
+
+#include "fake_tinyalsa.h"
+
+struct fake_resampler {
+    struct resampler_itfe itfe;
+    struct resampler_buffer_provider *provider;
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t channels;
+    /* input position of the next output frame, in 1/out_rate frames of
+       the input not consumed yet */
+    uint64_t phase;
+};
+
+pid_t fake_gettid(void)
+{
+    return syscall(SYS_gettid);
+}
+
+static void fake_resampler_reset(struct resampler_itfe *itfe)
+{
+    struct fake_resampler *rsmp = (struct fake_resampler *)itfe;
+
+    rsmp->phase = 0;
+}
+
+/* converts from in_frames of in into at most *out_frames of out. Returns
+ * the input frames consumed, and the output frames made in *out_frames */
+static size_t fake_resample(struct fake_resampler *rsmp, const int16_t *in,
+                            size_t in_frames, int16_t *out,
+                            size_t *out_frames)
+{
+    size_t frames = 0;
+    size_t used;
+    uint64_t index;
+
+    while (frames < *out_frames) {
+        index = rsmp->phase / rsmp->out_rate;
+        if (index >= in_frames)
+            break;
+        memcpy(out + frames * rsmp->channels, in + index * rsmp->channels,
+               rsmp->channels * sizeof(int16_t));
+        rsmp->phase += rsmp->in_rate;
+        frames++;
+    }
+
+    used = rsmp->phase / rsmp->out_rate;
+    if (used > in_frames)
+        used = in_frames;
+    rsmp->phase -= (uint64_t)used * rsmp->out_rate;
+    *out_frames = frames;
+    return used;
+}
+
+static int fake_resampler_resample_from_input(struct resampler_itfe *itfe,
+                                              int16_t *in, size_t *in_frames,
+                                              int16_t *out,
+                                              size_t *out_frames)
+{
+    struct fake_resampler *rsmp = (struct fake_resampler *)itfe;
+
+    if (!in || !in_frames || !out || !out_frames)
+        return -EINVAL;
+    *in_frames = fake_resample(rsmp, in, *in_frames, out, out_frames);
+    return 0;
+}
+
+static int fake_resampler_resample_from_provider(struct resampler_itfe *itfe,
+                                                 int16_t *out,
+                                                 size_t *out_frames)
+{
+    struct fake_resampler *rsmp = (struct fake_resampler *)itfe;
+    struct resampler_buffer buffer;
+    size_t frames = 0;
+    size_t made;
+
+    if (!rsmp->provider || !out || !out_frames)
+        return -EINVAL;
+
+    while (frames < *out_frames) {
+        made = *out_frames - frames;
+        buffer.frame_count = made * rsmp->in_rate / rsmp->out_rate + 1;
+        rsmp->provider->get_next_buffer(rsmp->provider, &buffer);
+        if (!buffer.raw || buffer.frame_count == 0)
+            break;
+        buffer.frame_count = fake_resample(rsmp, buffer.i16,
+                                           buffer.frame_count,
+                                           out + frames * rsmp->channels,
+                                           &made);
+        rsmp->provider->release_buffer(rsmp->provider, &buffer);
+        frames += made;
+    }
+
+    *out_frames = frames;
+    return 0;
+}
+
+static int32_t fake_resampler_delay_ns(struct resampler_itfe *itfe)
+{
+    return 0;
+}
+
+int create_resampler(uint32_t inSampleRate, uint32_t outSampleRate,
+                     uint32_t channelCount, uint32_t quality,
+                     struct resampler_buffer_provider *provider,
+                     struct resampler_itfe **resampler)
+{
+    struct fake_resampler *rsmp;
+
+    if (!resampler || inSampleRate == 0 || outSampleRate == 0 ||
+            (channelCount != 1 && channelCount != 2))
+        return -EINVAL;
+
+    rsmp = calloc(1, sizeof(*rsmp));
+    if (!rsmp)
+        return -ENOMEM;
+    rsmp->itfe.reset = fake_resampler_reset;
+    rsmp->itfe.resample_from_input = fake_resampler_resample_from_input;
+    rsmp->itfe.resample_from_provider = fake_resampler_resample_from_provider;
+    rsmp->itfe.delay_ns = fake_resampler_delay_ns;
+    rsmp->provider = provider;
+    rsmp->in_rate = inSampleRate;
+    rsmp->out_rate = outSampleRate;
+    rsmp->channels = channelCount;
+
+    *resampler = &rsmp->itfe;
+    return 0;
+}
+
+void release_resampler(struct resampler_itfe *resampler)
+{
+    free(resampler);
+}
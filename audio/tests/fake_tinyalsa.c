@@ -0,0 +1,783 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* the tests build with -Dclock_nanosleep=fake_clock_nanosleep, which wraps
+ * the real one */
+#undef clock_nanosleep
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <tinyalsa/asoundlib.h>
+
+#include "fake_tinyalsa.h"
+
+#define NSEC_PER_SEC 1000000000LL
+
+#define FAKE_MAX_DEVICES 8
+#define FAKE_MAX_ENUMS 8
+#define FAKE_MAX_VALUES 2
+#define FAKE_MAX_PROPERTIES 16
+#define FAKE_CTL_HASH_SIZE 4096 /* must be a power of 2 */
+
+/* the XML the mixer takes its ctl names from, see MIXER_XML_PATH */
+#ifndef FAKE_MIXER_XML_PATH
+#define FAKE_MIXER_XML_PATH "/system/etc/mixer_paths.xml"
+#endif
+
+struct pcm {
+    unsigned int device;
+    unsigned int flags;
+    struct pcm_config config;
+    bool busy;
+    unsigned int buffer_size;
+    clockid_t clock;
+    /* the hw pointer moves at the rate from start_ns on, hw_base being
+     * its position at that time */
+    bool running;
+    int64_t start_ns;
+    uint64_t hw_base;
+    uint64_t appl; /* frames written or read */
+    bool xrun; /* the mmap transport found an xrun, until pcm_prepare() */
+    int16_t *area; /* the mmap ring */
+};
+
+struct mixer_ctl {
+    char name[64];
+    enum mixer_ctl_type type;
+    unsigned int num_values;
+    int values[FAKE_MAX_VALUES];
+    char *enums[FAKE_MAX_ENUMS];
+    unsigned int num_enums;
+    int hash_next; /* next ctl in the same mixer->ctl_hash chain, or -1 */
+};
+
+struct mixer {
+    struct mixer_ctl *ctls;
+    unsigned int num_ctls;
+    unsigned int max_ctls;
+    /* first ctl of each name hash chain, or -1. It only serves to load the
+     * XML quickly, lookups by the route code scan the ctls as tinyalsa's
+     * mixer_get_ctl_by_name() does */
+    int ctl_hash[FAKE_CTL_HASH_SIZE];
+};
+
+struct fake_property {
+    char key[PROPERTY_KEY_MAX];
+    char value[PROPERTY_VALUE_MAX];
+};
+
+struct fake_stats fake_stats;
+unsigned int fake_mixer_extra_ctls;
+unsigned int fake_mixer_ioctl_us;
+void (*fake_pcm_write_hook)(unsigned int device, const int16_t *data,
+                            unsigned int frames, unsigned int channels);
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+/* open PCMs, by device and direction */
+static struct pcm *fake_pcms[FAKE_MAX_DEVICES][2];
+static struct fake_property fake_properties[FAKE_MAX_PROPERTIES];
+
+static int64_t clock_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+int64_t fake_now_ns(void)
+{
+    return clock_ns(CLOCK_MONOTONIC);
+}
+
+static void sleep_ns(int64_t ns)
+{
+    struct timespec ts;
+
+    if (ns <= 0)
+        return;
+    ts.tv_sec = ns / NSEC_PER_SEC;
+    ts.tv_nsec = ns % NSEC_PER_SEC;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+}
+
+void fake_reset(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    memset(&fake_stats, 0, sizeof(fake_stats));
+    pthread_mutex_unlock(&fake_lock);
+}
+
+/* PCM */
+
+static uint64_t pcm_hw_position(struct pcm *pcm)
+{
+    if (!pcm->running)
+        return pcm->hw_base;
+    return pcm->hw_base + (uint64_t)((clock_ns(pcm->clock) - pcm->start_ns) *
+                                     pcm->config.rate / NSEC_PER_SEC);
+}
+
+static void pcm_run(struct pcm *pcm)
+{
+    pcm->running = true;
+    pcm->start_ns = clock_ns(pcm->clock);
+}
+
+/* stops the PCM where the hw pointer ran past the application pointer */
+static bool pcm_check_xrun(struct pcm *pcm)
+{
+    uint64_t hw = pcm_hw_position(pcm);
+    bool xrun;
+
+    if (!pcm->running)
+        return false;
+    if (pcm->flags & PCM_IN)
+        xrun = hw - pcm->appl > pcm->buffer_size;
+    else
+        xrun = hw > pcm->appl;
+    if (!xrun)
+        return false;
+
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.xruns++;
+    pthread_mutex_unlock(&fake_lock);
+    pcm->running = false;
+    if (pcm->flags & PCM_IN)
+        pcm->appl = hw;
+    pcm->hw_base = pcm->appl;
+    return true;
+}
+
+static unsigned int pcm_frames_queued(struct pcm *pcm)
+{
+    uint64_t hw = pcm_hw_position(pcm);
+
+    if (pcm->flags & PCM_IN)
+        return hw > pcm->appl ? hw - pcm->appl : 0;
+    return pcm->appl > hw ? pcm->appl - hw : 0;
+}
+
+struct pcm *pcm_open(unsigned int card, unsigned int device,
+                     unsigned int flags, struct pcm_config *config)
+{
+    struct pcm *pcm = calloc(1, sizeof(struct pcm));
+    int dir = (flags & PCM_IN) ? 1 : 0;
+
+    if (!pcm)
+        return NULL;
+    pcm->device = device;
+    pcm->flags = flags;
+    pcm->config = *config;
+    pcm->buffer_size = config->period_size * config->period_count;
+    if (!pcm->config.start_threshold)
+        pcm->config.start_threshold = (flags & PCM_IN) ? 1 :
+                pcm->buffer_size / 2;
+    pcm->clock = (flags & PCM_MONOTONIC) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
+    if (flags & PCM_MMAP)
+        pcm->area = calloc(pcm->buffer_size,
+                           config->channels * sizeof(int16_t));
+
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.pcm_opens++;
+    if (device >= FAKE_MAX_DEVICES || fake_pcms[device][dir]) {
+        fake_stats.pcm_busy_opens++;
+        pcm->busy = true;
+    } else {
+        fake_pcms[device][dir] = pcm;
+    }
+    pthread_mutex_unlock(&fake_lock);
+
+    /* capture runs from the open, as the HAL never starts read PCMs */
+    if ((flags & PCM_IN) && !(flags & PCM_MMAP))
+        pcm_run(pcm);
+
+    return pcm;
+}
+
+int pcm_close(struct pcm *pcm)
+{
+    int dir;
+
+    if (!pcm)
+        return 0;
+    dir = (pcm->flags & PCM_IN) ? 1 : 0;
+    pthread_mutex_lock(&fake_lock);
+    if (!pcm->busy)
+        fake_pcms[pcm->device][dir] = NULL;
+    pthread_mutex_unlock(&fake_lock);
+    free(pcm->area);
+    free(pcm);
+    return 0;
+}
+
+int pcm_is_ready(struct pcm *pcm)
+{
+    return !pcm->busy;
+}
+
+const char *pcm_get_error(struct pcm *pcm)
+{
+    return pcm->busy ? "device busy" : "";
+}
+
+unsigned int pcm_get_buffer_size(struct pcm *pcm)
+{
+    return pcm->buffer_size;
+}
+
+unsigned int pcm_frames_to_bytes(struct pcm *pcm, unsigned int frames)
+{
+    return frames * pcm->config.channels * sizeof(int16_t);
+}
+
+unsigned int pcm_bytes_to_frames(struct pcm *pcm, unsigned int bytes)
+{
+    return bytes / (pcm->config.channels * sizeof(int16_t));
+}
+
+unsigned int pcm_format_to_bits(enum pcm_format format)
+{
+    return format == PCM_FORMAT_S32_LE ? 32 : 16;
+}
+
+int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail,
+                       struct timespec *tstamp)
+{
+    unsigned int queued = pcm_frames_queued(pcm);
+
+    clock_gettime(pcm->clock, tstamp);
+    if (pcm->flags & PCM_IN)
+        *avail = queued > pcm->buffer_size ? pcm->buffer_size : queued;
+    else
+        *avail = pcm->buffer_size - queued;
+    return 0;
+}
+
+int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    unsigned int frames = pcm_bytes_to_frames(pcm, count);
+    unsigned int queued;
+
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.pcm_writes++;
+    pthread_mutex_unlock(&fake_lock);
+    if (frames > pcm->buffer_size)
+        return -EINVAL;
+    if (pcm_check_xrun(pcm))
+        return -EPIPE;
+
+    /* block until there is room, as a full ring would */
+    while ((queued = pcm_frames_queued(pcm)) + frames > pcm->buffer_size)
+        sleep_ns((int64_t)(queued + frames - pcm->buffer_size) *
+                 NSEC_PER_SEC / pcm->config.rate + 1);
+
+    if (fake_pcm_write_hook)
+        fake_pcm_write_hook(pcm->device, (const int16_t *)data, frames,
+                            pcm->config.channels);
+    pcm->appl += frames;
+    if (!pcm->running &&
+            pcm->appl - pcm->hw_base >= pcm->config.start_threshold)
+        pcm_run(pcm);
+    return 0;
+}
+
+int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    unsigned int frames = pcm_bytes_to_frames(pcm, count);
+    unsigned int queued;
+    int16_t *samples = (int16_t *)data;
+    unsigned int i;
+
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.pcm_reads++;
+    pthread_mutex_unlock(&fake_lock);
+    if (frames > pcm->buffer_size)
+        return -EINVAL;
+    if (pcm_check_xrun(pcm))
+        pcm_run(pcm);
+
+    while ((queued = pcm_frames_queued(pcm)) < frames)
+        sleep_ns((int64_t)(frames - queued) * NSEC_PER_SEC /
+                 pcm->config.rate + 1);
+
+    /* a ramp, so that lost or repeated frames show */
+    for (i = 0; i < frames * pcm->config.channels; i++)
+        samples[i] = (int16_t)(pcm->appl + i / pcm->config.channels);
+    pcm->appl += frames;
+    return 0;
+}
+
+int pcm_start(struct pcm *pcm)
+{
+    if (!pcm->running)
+        pcm_run(pcm);
+    return 0;
+}
+
+int pcm_stop(struct pcm *pcm)
+{
+    pcm->hw_base = pcm_hw_position(pcm);
+    pcm->running = false;
+    return 0;
+}
+
+int pcm_prepare(struct pcm *pcm)
+{
+    pcm->running = false;
+    pcm->xrun = false;
+    if (pcm->flags & PCM_IN)
+        pcm->appl = pcm->hw_base;
+    else
+        pcm->hw_base = pcm->appl;
+    return 0;
+}
+
+/* counts an xrun the mmap transport found, once until the PCM is prepared */
+static int pcm_mmap_xrun(struct pcm *pcm)
+{
+    if (!pcm->xrun) {
+        pcm->xrun = true;
+        pthread_mutex_lock(&fake_lock);
+        fake_stats.xruns++;
+        pthread_mutex_unlock(&fake_lock);
+    }
+    return -EPIPE;
+}
+
+int pcm_mmap_avail(struct pcm *pcm)
+{
+    unsigned int queued = pcm_frames_queued(pcm);
+
+    if (pcm->flags & PCM_IN) {
+        if (queued > pcm->buffer_size)
+            return pcm_mmap_xrun(pcm);
+        return queued;
+    }
+    if (pcm->running && pcm_hw_position(pcm) > pcm->appl)
+        return pcm_mmap_xrun(pcm);
+    return pcm->buffer_size - queued;
+}
+
+int pcm_avail_update(struct pcm *pcm)
+{
+    return pcm_mmap_avail(pcm);
+}
+
+int pcm_mmap_begin(struct pcm *pcm, void **areas, unsigned int *offset,
+                   unsigned int *frames)
+{
+    int avail = pcm_mmap_avail(pcm);
+    unsigned int channels = pcm->config.channels;
+    unsigned int contiguous;
+    unsigned int i;
+
+    if (avail < 0)
+        return avail;
+    *offset = pcm->appl % pcm->buffer_size;
+    contiguous = pcm->buffer_size - *offset;
+    if (*frames > (unsigned int)avail)
+        *frames = avail;
+    if (*frames > contiguous)
+        *frames = contiguous;
+    *areas = pcm->area;
+
+    /* the same ramp as pcm_read(), as the DMA would have written it */
+    if (pcm->flags & PCM_IN)
+        for (i = 0; i < *frames * channels; i++)
+            pcm->area[*offset * channels + i] =
+                    (int16_t)(pcm->appl + i / channels);
+    return 0;
+}
+
+int pcm_mmap_commit(struct pcm *pcm, unsigned int offset,
+                    unsigned int frames)
+{
+    if (offset != pcm->appl % pcm->buffer_size)
+        return -EINVAL;
+    if (!(pcm->flags & PCM_IN) && fake_pcm_write_hook)
+        fake_pcm_write_hook(pcm->device,
+                            pcm->area + offset * pcm->config.channels,
+                            frames, pcm->config.channels);
+    pcm->appl += frames;
+    return frames;
+}
+
+int pcm_wait(struct pcm *pcm, int timeout)
+{
+    int64_t deadline = fake_now_ns() + (int64_t)timeout * 1000000;
+    unsigned int avail_min = pcm->config.avail_min ?
+            (unsigned int)pcm->config.avail_min : pcm->config.period_size;
+    int avail;
+
+    if (!pcm->running)
+        return -EPIPE;
+    for (;;) {
+        avail = pcm_mmap_avail(pcm);
+        if (avail < 0)
+            return avail;
+        if ((unsigned int)avail >= avail_min)
+            return 1;
+        if (fake_now_ns() >= deadline)
+            return 0;
+        sleep_ns((int64_t)(avail_min - avail) * NSEC_PER_SEC /
+                 pcm->config.rate + 1);
+    }
+}
+
+int fake_pcm_get_delay(unsigned int device)
+{
+    struct pcm *pcm;
+    int delay = -1;
+
+    pthread_mutex_lock(&fake_lock);
+    pcm = device < FAKE_MAX_DEVICES ? fake_pcms[device][0] : NULL;
+    if (pcm)
+        delay = pcm_frames_queued(pcm);
+    pthread_mutex_unlock(&fake_lock);
+    return delay;
+}
+
+unsigned int fake_pcm_get_rate(unsigned int device, unsigned int flags)
+{
+    struct pcm *pcm;
+    unsigned int rate = 0;
+
+    pthread_mutex_lock(&fake_lock);
+    pcm = device < FAKE_MAX_DEVICES ?
+            fake_pcms[device][(flags & PCM_IN) ? 1 : 0] : NULL;
+    if (pcm)
+        rate = pcm->config.rate;
+    pthread_mutex_unlock(&fake_lock);
+    return rate;
+}
+
+/* Mixer */
+
+static void mixer_ioctl(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.mixer_ioctls++;
+    pthread_mutex_unlock(&fake_lock);
+    if (fake_mixer_ioctl_us)
+        usleep(fake_mixer_ioctl_us);
+}
+
+static bool is_number(const char *s)
+{
+    char *end;
+
+    strtol(s, &end, 0);
+    return *s && !*end;
+}
+
+static unsigned int ctl_name_hash(const char *name)
+{
+    unsigned int hash = 5381;
+
+    while (*name)
+        hash = hash * 33 + (unsigned char)*name++;
+    return hash & (FAKE_CTL_HASH_SIZE - 1);
+}
+
+static struct mixer_ctl *mixer_new_ctl(struct mixer *mixer, const char *name)
+{
+    unsigned int hash = ctl_name_hash(name);
+    struct mixer_ctl *ctl;
+    void *new_ctls;
+
+    if (mixer->num_ctls == mixer->max_ctls) {
+        new_ctls = realloc(mixer->ctls, (mixer->max_ctls * 2 + 16) *
+                           sizeof(struct mixer_ctl));
+        if (!new_ctls)
+            return NULL;
+        mixer->ctls = (struct mixer_ctl *)new_ctls;
+        mixer->max_ctls = mixer->max_ctls * 2 + 16;
+    }
+    ctl = &mixer->ctls[mixer->num_ctls++];
+    memset(ctl, 0, sizeof(*ctl));
+    snprintf(ctl->name, sizeof(ctl->name), "%s", name);
+    ctl->type = MIXER_CTL_TYPE_INT;
+    ctl->num_values = 1;
+    ctl->hash_next = mixer->ctl_hash[hash];
+    mixer->ctl_hash[hash] = mixer->num_ctls - 1;
+    return ctl;
+}
+
+static struct mixer_ctl *mixer_add_ctl(struct mixer *mixer, const char *name)
+{
+    struct mixer_ctl *ctl;
+    int i;
+
+    for (i = mixer->ctl_hash[ctl_name_hash(name)]; i >= 0;
+            i = mixer->ctls[i].hash_next)
+        if (strcmp(mixer->ctls[i].name, name) == 0)
+            return &mixer->ctls[i];
+
+    ctl = mixer_new_ctl(mixer, name);
+    if (!ctl)
+        return NULL;
+    if (strstr(name, "Switch"))
+        ctl->type = MIXER_CTL_TYPE_BOOL;
+    if (strstr(name, "Volume"))
+        ctl->num_values = 2;
+    return ctl;
+}
+
+/* an enum ctl gets the strings the XML sets it to as its enum values */
+static void mixer_add_value(struct mixer_ctl *ctl, const char *value)
+{
+    unsigned int i;
+
+    if (!ctl || is_number(value))
+        return;
+    ctl->type = MIXER_CTL_TYPE_ENUM;
+    for (i = 0; i < ctl->num_enums; i++)
+        if (strcmp(ctl->enums[i], value) == 0)
+            return;
+    if (ctl->num_enums < FAKE_MAX_ENUMS)
+        ctl->enums[ctl->num_enums++] = strdup(value);
+}
+
+/* picks the name and value attributes out of each <ctl> of the XML, which
+ * is all the route code needs to find in the mixer */
+static void mixer_load_xml(struct mixer *mixer)
+{
+    FILE *file = fopen(FAKE_MIXER_XML_PATH, "r");
+    char line[256];
+    char name[64];
+    char value[64];
+    char *tag;
+
+    if (!file)
+        return;
+    while (fgets(line, sizeof(line), file)) {
+        tag = strstr(line, "<ctl ");
+        if (!tag || sscanf(tag, "<ctl name=\"%63[^\"]\" value=\"%63[^\"]\"",
+                           name, value) != 2)
+            continue;
+        mixer_add_value(mixer_add_ctl(mixer, name), value);
+    }
+    fclose(file);
+}
+
+/* the extra ctls come first, so that the ctls of the XML have the highest
+ * indices, as on a codec with many more ctls than its paths use */
+struct mixer *mixer_open(unsigned int card)
+{
+    struct mixer *mixer = calloc(1, sizeof(struct mixer));
+    char name[64];
+    unsigned int i;
+
+    if (!mixer)
+        return NULL;
+    memset(mixer->ctl_hash, -1, sizeof(mixer->ctl_hash));
+    for (i = 0; i < fake_mixer_extra_ctls; i++) {
+        snprintf(name, sizeof(name), "Fake ctl %u", i);
+        if (!mixer_new_ctl(mixer, name)) {
+            mixer_close(mixer);
+            return NULL;
+        }
+    }
+    mixer_load_xml(mixer);
+    return mixer;
+}
+
+void mixer_close(struct mixer *mixer)
+{
+    unsigned int i;
+    unsigned int j;
+
+    if (!mixer)
+        return;
+    for (i = 0; i < mixer->num_ctls; i++)
+        for (j = 0; j < mixer->ctls[i].num_enums; j++)
+            free(mixer->ctls[i].enums[j]);
+    free(mixer->ctls);
+    free(mixer);
+}
+
+const char *mixer_get_name(struct mixer *mixer)
+{
+    return "fake";
+}
+
+unsigned int mixer_get_num_ctls(struct mixer *mixer)
+{
+    return mixer->num_ctls;
+}
+
+struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
+{
+    return id < mixer->num_ctls ? &mixer->ctls[id] : NULL;
+}
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    unsigned int i;
+
+    for (i = 0; i < mixer->num_ctls; i++)
+        if (strcmp(mixer->ctls[i].name, name) == 0)
+            return &mixer->ctls[i];
+    return NULL;
+}
+
+const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
+{
+    return ctl->name;
+}
+
+enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
+{
+    return ctl->type;
+}
+
+unsigned int mixer_ctl_get_num_values(struct mixer_ctl *ctl)
+{
+    return ctl->num_values;
+}
+
+unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
+{
+    return ctl->num_enums;
+}
+
+const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl,
+                                      unsigned int enum_id)
+{
+    return enum_id < ctl->num_enums ? ctl->enums[enum_id] : NULL;
+}
+
+int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    mixer_ioctl();
+    return id < ctl->num_values ? ctl->values[id] : -EINVAL;
+}
+
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
+{
+    mixer_ioctl();
+    if (id >= ctl->num_values)
+        return -EINVAL;
+    ctl->values[id] = value;
+    return 0;
+}
+
+int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
+{
+    long *values = (long *)array;
+    size_t i;
+
+    mixer_ioctl();
+    if (ctl->type == MIXER_CTL_TYPE_ENUM || count > ctl->num_values)
+        return -EINVAL;
+    for (i = 0; i < count; i++)
+        values[i] = ctl->values[i];
+    return 0;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array,
+                        size_t count)
+{
+    const long *values = (const long *)array;
+    size_t i;
+
+    mixer_ioctl();
+    if (ctl->type == MIXER_CTL_TYPE_ENUM || count > ctl->num_values)
+        return -EINVAL;
+    for (i = 0; i < count; i++)
+        ctl->values[i] = values[i];
+    return 0;
+}
+
+/* Properties */
+
+void fake_property_set(const char *key, const char *value)
+{
+    struct fake_property *free_slot = NULL;
+    unsigned int i;
+
+    for (i = 0; i < FAKE_MAX_PROPERTIES; i++) {
+        struct fake_property *prop = &fake_properties[i];
+
+        if (prop->key[0] && strcmp(prop->key, key) == 0) {
+            if (value)
+                snprintf(prop->value, sizeof(prop->value), "%s", value);
+            else
+                prop->key[0] = '\0';
+            return;
+        }
+        if (!prop->key[0] && !free_slot)
+            free_slot = prop;
+    }
+    if (value && free_slot) {
+        snprintf(free_slot->key, sizeof(free_slot->key), "%s", key);
+        snprintf(free_slot->value, sizeof(free_slot->value), "%s", value);
+    }
+}
+
+int fake_property_get(const char *key, char *value, const char *default_value)
+{
+    unsigned int i;
+
+    for (i = 0; i < FAKE_MAX_PROPERTIES; i++) {
+        if (fake_properties[i].key[0] &&
+                strcmp(fake_properties[i].key, key) == 0) {
+            strcpy(value, fake_properties[i].value);
+            return strlen(value);
+        }
+    }
+    if (!default_value) {
+        value[0] = '\0';
+        return 0;
+    }
+    strcpy(value, default_value);
+    return strlen(value);
+}
+
+/* Pacing */
+
+int fake_clock_nanosleep(clockid_t clock_id, int flags,
+                         const struct timespec *request,
+                         struct timespec *remain)
+{
+    int64_t deadline = request->tv_sec * NSEC_PER_SEC + request->tv_nsec;
+    int64_t late;
+    int ret;
+
+    if (!(flags & TIMER_ABSTIME))
+        deadline += clock_ns(clock_id);
+    ret = clock_nanosleep(clock_id, flags, request, remain);
+    late = clock_ns(clock_id) - deadline;
+
+    pthread_mutex_lock(&fake_lock);
+    fake_stats.sleeps++;
+    fake_stats.sleep_late_ns += late;
+    if (late > fake_stats.sleep_max_late_ns)
+        fake_stats.sleep_max_late_ns = late;
+    pthread_mutex_unlock(&fake_lock);
+
+    return ret;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FAKE_TINYALSA_H
+#define FAKE_TINYALSA_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/* Stand-ins for libtinyalsa, the properties and clock_nanosleep() that the
+   tests link the HAL and the route code against, so that they run without
+   touching the sound card or the system properties.
+
+   A PCM plays or captures at its rate from the moment it starts, on the
+   clock its flags select, and under or overruns like the driver would.
+   Only one PCM may be open per device and direction, a second pcm_open()
+   returns a PCM that is not ready. The mixer has a ctl for each name found
+   in the mixer paths XML, plus fake_mixer_extra_ctls more. */
+
+/* Counters, reset by fake_reset() */
+struct fake_stats {
+    unsigned int pcm_opens;
+    unsigned int pcm_busy_opens; /* the device was already open */
+    unsigned int pcm_writes;
+    unsigned int pcm_reads;
+    unsigned int xruns;
+    unsigned int mixer_ioctls;
+    /* clock_nanosleep() calls of the HAL, and how late they returned */
+    unsigned int sleeps;
+    int64_t sleep_late_ns;
+    int64_t sleep_max_late_ns;
+};
+
+extern struct fake_stats fake_stats;
+
+/* mixer ctls added before the ones of the XML, named "Fake ctl <n>" */
+extern unsigned int fake_mixer_extra_ctls;
+/* time each ctl read or write takes, as a slow control bus would */
+extern unsigned int fake_mixer_ioctl_us;
+
+/* called with the frames of each pcm_write() or committed mmap area */
+extern void (*fake_pcm_write_hook)(unsigned int device, const int16_t *data,
+                                   unsigned int frames,
+                                   unsigned int channels);
+
+void fake_reset(void);
+
+/* frames queued in the output PCM of device, or -1 if it is not open */
+int fake_pcm_get_delay(unsigned int device);
+/* the rate the PCM of device and direction (PCM_IN or PCM_OUT) was opened
+   at, 0 if it is not open */
+unsigned int fake_pcm_get_rate(unsigned int device, unsigned int flags);
+
+/* property_get() of the HAL reads these, NULL value to remove a key */
+void fake_property_set(const char *key, const char *value);
+int fake_property_get(const char *key, char *value, const char *default_value);
+
+int fake_clock_nanosleep(clockid_t clock_id, int flags,
+                         const struct timespec *request,
+                         struct timespec *remain);
+
+int64_t fake_now_ns(void);
+
+/* fake_host.c, for the host build, where the HAL is built with
+   -Dgettid=fake_gettid */
+pid_t fake_gettid(void);
+
+#endif